@@ -0,0 +1,99 @@
+// Benchmark of CP866 decoding: Cp866Decoder against iconv with a descriptor opened per call, the former
+// cp866_to_utf8. The outputs of both are compared first.
+// Usage: cp866_decoder_bench [KB = 64] [iterations = 2000]
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <iconv.h>
+#include "cp866_decoder.h"
+
+namespace {
+
+// The former cp866_to_utf8, with room for the 3 bytes of box drawing characters
+std::string iconvConvert(const std::string& input, const char* to, size_t outPerByte) {
+    iconv_t conv = iconv_open(to, "CP866");
+    if (conv == (iconv_t)-1) {
+        return "";
+    }
+    size_t inBytesLeft = input.size();
+    size_t outBytesLeft = inBytesLeft * outPerByte;
+    std::vector<char> outBuf(outBytesLeft);
+    char* inBuf = const_cast<char*>(input.data());
+    char* outPtr = outBuf.data();
+    if (iconv(conv, &inBuf, &inBytesLeft, &outPtr, &outBytesLeft) == (size_t)-1) {
+        iconv_close(conv);
+        return "";
+    }
+    iconv_close(conv);
+    return std::string(outBuf.data(), outBuf.size() - outBytesLeft);
+}
+
+// Text of a REXPR file: mostly ASCII samples, or mostly Cyrillic lines with box drawing
+std::string sample(size_t size, bool cyrillic) {
+    std::mt19937 random(5);
+    std::string out(size, '\0');
+    for (auto& c : out) {
+        unsigned value = random() % 0x80;
+        if (cyrillic && random() % 4 != 0) {
+            value = 0x80 + random() % 0x80;
+        }
+        c = static_cast<char>(value == 0 ? ' ' : value);
+    }
+    return out;
+}
+
+template <class Decode>
+double microseconds(size_t iterations, Decode decode) {
+    size_t bytes = 0;
+    auto started = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        bytes += decode();
+    }
+    double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count();
+    // Keeps the calls from being optimized away
+    if (bytes == 0) {
+        std::printf("nothing decoded\n");
+    }
+    return elapsed / iterations;
+}
+
+bool compare(const char* name, const std::string& input, size_t iterations) {
+    Cp866Decoder& decoder = Cp866Decoder::forThisThread();
+    const std::string& utf8 = decoder.toUtf8(input.data(), input.size());
+    const std::wstring& wide = decoder.toWide(input.data(), input.size());
+    std::string iconvWide = iconvConvert(input, "WCHAR_T", sizeof(wchar_t));
+    if (utf8 != iconvConvert(input, "UTF-8", 3) ||
+        iconvWide != std::string(reinterpret_cast<const char*>(wide.data()), wide.size() * sizeof(wchar_t))) {
+        std::printf("%-8s outputs differ from iconv\n", name);
+        return false;
+    }
+
+    double formerUtf8 = microseconds(iterations, [&] { return iconvConvert(input, "UTF-8", 3).size(); });
+    double tableUtf8 = microseconds(iterations, [&] { return decoder.toUtf8(input.data(), input.size()).size(); });
+    double formerWide = microseconds(iterations, [&] { return iconvConvert(input, "WCHAR_T", sizeof(wchar_t)).size(); });
+    double tableWide = microseconds(iterations, [&] { return decoder.toWide(input.data(), input.size()).size(); });
+    std::printf("%-8s %8zu bytes  UTF-8: iconv %9.1f us  table %8.1f us  x%-5.1f  wide: iconv %9.1f us  table %8.1f us  x%.1f\n",
+        name, input.size(), formerUtf8, tableUtf8, formerUtf8 / tableUtf8, formerWide, tableWide, formerWide / tableWide);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const size_t size = (argc > 1 ? std::stoul(argv[1]) : 64) * 1024;
+    const size_t iterations = argc > 2 ? std::stoul(argv[2]) : 2000;
+
+    // Every byte of the code page once
+    std::string all;
+    for (int b = 1; b < 256; ++b) {
+        all += static_cast<char>(b);
+    }
+
+    bool same = compare("table", all, iterations);
+    same = compare("ascii", sample(size, false), iterations) && same;
+    same = compare("cyrillic", sample(size, true), iterations) && same;
+    return same ? 0 : 1;
+}
@@ -0,0 +1,404 @@
+// Benchmark of writing data rows: one INSERT ... OUTPUT per record, as insertIntoDataTable does without the allocator,
+// against the parameter arrays of insertIntoDataTableBatch, with generated and with allocated ids.
+// Usage: data_insert_bench [connection string] [records = 2000] [batch = 100] [file KB = 16]
+// The default connection string is the LocalDB instance of the developer machine. Rows go to the
+// temporary table #data of the connection, shaped as [data], so no database is changed. Every record
+// is a RECON and REXPR pair, both contents sent with SQLPutData as the service sends them.
+// The statements repeat the ones of integration_handler.cpp, which keeps them private
+
+#include <Windows.h>
+#include <sqlext.h>
+#include <sqltypes.h>
+#include <sql.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+const wchar_t* DEFAULT_CONNECTION =
+    L"DRIVER={ODBC Driver 17 for SQL Server};SERVER=(localdb)\\MSSQLLocalDB;Trusted_Connection=Yes";
+
+// Size of the pieces a file content is uploaded in, as in the service
+const size_t UPLOAD_CHUNK_SIZE = 64 * 1024;
+
+// The allocated ids start far above the generated ones of the other modes
+const int ALLOCATED_ID_BASE = 100000000;
+
+struct Record {
+    int structId = 0;
+    std::wstring date;
+    std::wstring time;
+    std::wstring fileNum;
+    std::string dataFile;
+    std::string expressFile;
+};
+
+struct RunResult {
+    size_t written = 0;     // Records that got an id
+    double seconds = 0;
+};
+
+// Content of a file sent with SQLPutData, bound as the buffer of a data-at-execution parameter
+struct BlobRef {
+    const char* data = nullptr;
+    SQLLEN size = 0;
+};
+
+// One element of the parameter array of a batch insert, bound row-wise as in insertIntoDataTableBatch
+struct DataRow {
+    SQLINTEGER id = 0;
+    SQLINTEGER structId = 0;
+    SQLWCHAR date[16] = {};
+    SQLWCHAR time[32] = {};
+    SQLWCHAR fileNum[16] = {};
+    SQLLEN textLen = SQL_NTS;
+    BlobRef blobs[2];
+    SQLLEN blobLen[2] = {};
+};
+
+void printSQLError(const char* message, SQLHANDLE handle, SQLSMALLINT type) {
+    SQLWCHAR sqlState[6], messageText[SQL_MAX_MESSAGE_LENGTH];
+    SQLINTEGER nativeError;
+    SQLSMALLINT textLength;
+    if (SQL_SUCCEEDED(SQLGetDiagRec(type, handle, 1, sqlState, &nativeError, messageText, SQL_MAX_MESSAGE_LENGTH, &textLength))) {
+        std::printf("%s: [%ls] %ls\n", message, sqlState, messageText);
+    }
+    else {
+        std::printf("%s\n", message);
+    }
+}
+
+bool executeDirect(SQLHDBC dbc, const wchar_t* sql) {
+    SQLHSTMT hstmt = SQL_NULL_HSTMT;
+    if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, dbc, &hstmt))) {
+        return false;
+    }
+    SQLRETURN ret = SQLExecDirectW(hstmt, (SQLWCHAR*)sql, SQL_NTS);
+    if (!SQL_SUCCEEDED(ret) && ret != SQL_NO_DATA) {
+        printSQLError("Failed to execute statement", hstmt, SQL_HANDLE_STMT);
+    }
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    return SQL_SUCCEEDED(ret) || ret == SQL_NO_DATA;
+}
+
+// Rows and content bytes in #data, read back to check that every mode wrote the same
+bool countRows(SQLHDBC dbc, long long& rows, long long& bytes) {
+    SQLHSTMT hstmt = SQL_NULL_HSTMT;
+    if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, dbc, &hstmt))) {
+        return false;
+    }
+    const wchar_t* sql = L"SELECT COUNT_BIG(*), SUM(CAST(DATALENGTH([data_file]) + DATALENGTH([express_file]) AS BIGINT)) FROM #data;";
+    SQLRETURN ret = SQLExecDirectW(hstmt, (SQLWCHAR*)sql, SQL_NTS);
+    rows = bytes = 0;
+    if (SQL_SUCCEEDED(ret) && SQLFetch(hstmt) == SQL_SUCCESS) {
+        SQLLEN indicator = 0;
+        SQLGetData(hstmt, 1, SQL_C_SBIGINT, &rows, 0, &indicator);
+        SQLGetData(hstmt, 2, SQL_C_SBIGINT, &bytes, 0, &indicator);
+    }
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    return SQL_SUCCEEDED(ret);
+}
+
+void copyParameter(SQLWCHAR* target, size_t capacity, const std::wstring& value) {
+    size_t length = (std::min)(value.size(), capacity - 1);
+    std::copy(value.begin(), value.begin() + length, target);
+    target[length] = 0;
+}
+
+bool putContent(SQLHSTMT hstmt, const char* data, size_t size) {
+    for (size_t offset = 0; offset < size; offset += UPLOAD_CHUNK_SIZE) {
+        size_t length = (std::min)(UPLOAD_CHUNK_SIZE, size - offset);
+        if (!SQL_SUCCEEDED(SQLPutData(hstmt, (SQLPOINTER)(data + offset), static_cast<SQLLEN>(length)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Answering SQL_NEED_DATA, the token is the BlobRef of the parameter the driver asks for
+SQLRETURN sendContents(SQLHSTMT hstmt, SQLRETURN ret) {
+    while (ret == SQL_NEED_DATA) {
+        SQLPOINTER token = nullptr;
+        ret = SQLParamData(hstmt, &token);
+        if (ret == SQL_NEED_DATA) {
+            const BlobRef* blob = static_cast<const BlobRef*>(token);
+            if (!putContent(hstmt, blob->data, static_cast<size_t>(blob->size))) {
+                SQLCancel(hstmt);
+                return SQL_ERROR;
+            }
+        }
+    }
+    return ret;
+}
+
+// insertIntoDataTable with generated ids: a statement prepared, executed and freed per record, committed on its own
+int insertRecord(SQLHDBC dbc, const Record& record) {
+    SQLHSTMT hstmt = SQL_NULL_HSTMT;
+    if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, dbc, &hstmt))) {
+        return -1;
+    }
+
+    const wchar_t* sqlQuery = LR"(
+        INSERT INTO #data
+        ([struct_id], [date], [time], [file_num], [data_file], [express_file])
+        OUTPUT INSERTED.id
+        VALUES(?, ?, ?, ?, ?, ?);
+    )";
+
+    SQLRETURN ret = SQLPrepareW(hstmt, (SQLWCHAR*)sqlQuery, SQL_NTS);
+    if (!SQL_SUCCEEDED(ret)) {
+        printSQLError("Failed to prepare single-row insert", hstmt, SQL_HANDLE_STMT);
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        return -1;
+    }
+
+    int structId = record.structId;
+    std::wstring date = record.date;
+    std::wstring time = record.time;
+    std::wstring fileNum = record.fileNum;
+    BlobRef blobs[2] = {
+        { record.dataFile.data(), static_cast<SQLLEN>(record.dataFile.size()) },
+        { record.expressFile.data(), static_cast<SQLLEN>(record.expressFile.size()) }
+    };
+    SQLLEN blobLen[2] = { SQL_LEN_DATA_AT_EXEC(blobs[0].size), SQL_LEN_DATA_AT_EXEC(blobs[1].size) };
+
+    SQLBindParameter(hstmt, 1, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0, &structId, 0, nullptr);
+    SQLBindParameter(hstmt, 2, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, date.size(), 0,
+        (SQLWCHAR*)date.c_str(), (date.size() + 1) * sizeof(wchar_t), nullptr);
+    SQLBindParameter(hstmt, 3, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, time.size(), 0,
+        (SQLWCHAR*)time.c_str(), (time.size() + 1) * sizeof(wchar_t), nullptr);
+    SQLBindParameter(hstmt, 4, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,
+        (SQLWCHAR*)fileNum.c_str(), 0, nullptr);
+    for (int column = 0; column < 2; ++column) {
+        SQLBindParameter(hstmt, 5 + column, SQL_PARAM_INPUT, SQL_C_BINARY, SQL_LONGVARBINARY,
+            blobs[column].size, 0, &blobs[column], 0, &blobLen[column]);
+    }
+
+    ret = sendContents(hstmt, SQLExecute(hstmt));
+    if (!SQL_SUCCEEDED(ret)) {
+        printSQLError("Failed to execute single-row insert", hstmt, SQL_HANDLE_STMT);
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        return -1;
+    }
+
+    int dataId = -1;
+    if (SQLFetch(hstmt) == SQL_SUCCESS) {
+        SQLGetData(hstmt, 1, SQL_C_SLONG, &dataId, 0, nullptr);
+    }
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    return dataId;
+}
+
+// executeDataRows: one INSERT for the whole parameter array. With explicit ids the rows carry their
+// id, otherwise every parameter set returns its generated id as a result of its own
+size_t insertRows(SQLHDBC dbc, std::vector<DataRow>& rows, bool explicitIds) {
+    SQLHSTMT hstmt = SQL_NULL_HSTMT;
+    if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, dbc, &hstmt))) {
+        return 0;
+    }
+
+    const wchar_t* sqlQuery = explicitIds ? LR"(
+        INSERT INTO #data
+        ([struct_id], [date], [time], [file_num], [id], [data_file], [express_file])
+        VALUES(?, ?, ?, ?, ?, ?, ?);
+    )" : LR"(
+        INSERT INTO #data
+        ([struct_id], [date], [time], [file_num], [data_file], [express_file])
+        OUTPUT INSERTED.id
+        VALUES(?, ?, ?, ?, ?, ?);
+    )";
+
+    SQLRETURN ret = SQLPrepareW(hstmt, (SQLWCHAR*)sqlQuery, SQL_NTS);
+    if (!SQL_SUCCEEDED(ret)) {
+        printSQLError("Failed to prepare batch insert", hstmt, SQL_HANDLE_STMT);
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        return 0;
+    }
+
+    SQLSetStmtAttr(hstmt, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER)sizeof(DataRow), 0);
+    SQLSetStmtAttr(hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)rows.size(), 0);
+
+    DataRow& first = rows.front();
+    int paramIndex = 1;
+    SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0,
+        &first.structId, 0, nullptr);
+    SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 10, 0,
+        first.date, sizeof(first.date), &first.textLen);
+    SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 30, 0,
+        first.time, sizeof(first.time), &first.textLen);
+    SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,
+        first.fileNum, sizeof(first.fileNum), &first.textLen);
+    if (explicitIds) {
+        SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0,
+            &first.id, 0, nullptr);
+    }
+    for (int column = 0; column < 2; ++column) {
+        SQLLEN maxSize = 0;
+        for (const auto& row : rows) {
+            maxSize = (std::max)(maxSize, row.blobs[column].size);
+        }
+        SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_BINARY, SQL_LONGVARBINARY,
+            maxSize, 0, &first.blobs[column], 0, &first.blobLen[column]);
+    }
+
+    ret = sendContents(hstmt, SQLExecute(hstmt));
+    if (!SQL_SUCCEEDED(ret)) {
+        printSQLError("Failed to execute batch insert", hstmt, SQL_HANDLE_STMT);
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        return 0;
+    }
+
+    size_t written = explicitIds ? rows.size() : 0;
+    if (!explicitIds) {
+        do {
+            SQLSMALLINT resultColumns = 0;
+            SQLNumResultCols(hstmt, &resultColumns);
+            if (resultColumns == 0) {
+                continue;
+            }
+            while (SQLFetch(hstmt) == SQL_SUCCESS) {
+                int dataId = -1;
+                SQLGetData(hstmt, 1, SQL_C_SLONG, &dataId, 0, nullptr);
+                written += dataId != -1;
+            }
+        } while (SQL_SUCCEEDED(SQLMoreResults(hstmt)));
+    }
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    return written;
+}
+
+RunResult runSingleRows(SQLHDBC dbc, const std::vector<Record>& records) {
+    RunResult result;
+    auto started = std::chrono::steady_clock::now();
+    for (const auto& record : records) {
+        result.written += insertRecord(dbc, record) != -1;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return result;
+}
+
+// insertIntoDataTableBatch: a transaction per batch, the allocated ids stand for the IdAllocator block
+RunResult runBatches(SQLHDBC dbc, const std::vector<Record>& records, size_t batchSize, bool explicitIds) {
+    RunResult result;
+    auto started = std::chrono::steady_clock::now();
+    int nextId = ALLOCATED_ID_BASE;
+    for (size_t begin = 0; begin < records.size(); begin += batchSize) {
+        size_t end = (std::min)(records.size(), begin + batchSize);
+        std::vector<DataRow> rows(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            const Record& record = records[i];
+            DataRow& row = rows[i - begin];
+            row.id = nextId++;
+            row.structId = record.structId;
+            copyParameter(row.date, 16, record.date);
+            copyParameter(row.time, 32, record.time);
+            copyParameter(row.fileNum, 16, record.fileNum);
+            row.blobs[0] = { record.dataFile.data(), static_cast<SQLLEN>(record.dataFile.size()) };
+            row.blobs[1] = { record.expressFile.data(), static_cast<SQLLEN>(record.expressFile.size()) };
+            row.blobLen[0] = SQL_LEN_DATA_AT_EXEC(row.blobs[0].size);
+            row.blobLen[1] = SQL_LEN_DATA_AT_EXEC(row.blobs[1].size);
+        }
+
+        SQLSetConnectAttr(dbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_OFF, 0);
+        if (explicitIds) {
+            executeDirect(dbc, L"SET IDENTITY_INSERT #data ON;");
+        }
+        size_t written = insertRows(dbc, rows, explicitIds);
+        if (explicitIds) {
+            executeDirect(dbc, L"SET IDENTITY_INSERT #data OFF;");
+        }
+        bool succeeded = written == rows.size();
+        SQLEndTran(SQL_HANDLE_DBC, dbc, succeeded ? SQL_COMMIT : SQL_ROLLBACK);
+        SQLSetConnectAttr(dbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_ON, 0);
+        result.written += succeeded ? written : 0;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return result;
+}
+
+std::vector<Record> generateRecords(size_t count, size_t fileBytes) {
+    std::vector<Record> records(count);
+    for (size_t i = 0; i < count; ++i) {
+        Record& record = records[i];
+        wchar_t buffer[32];
+        record.structId = static_cast<int>(i % 1000) + 1;
+        swprintf(buffer, 32, L"2024-%02zu-%02zu", i % 12 + 1, i % 28 + 1);
+        record.date = buffer;
+        swprintf(buffer, 32, L"%02zu:%02zu:%02zu.%03zu", i % 24, i % 60, (i / 60) % 60, i % 1000);
+        record.time = buffer;
+        swprintf(buffer, 32, L"%03zu.%03zu", (i / 1000) % 1000, i % 1000);
+        record.fileNum = buffer;
+        record.dataFile.assign(fileBytes, static_cast<char>('A' + i % 26));
+        record.expressFile.assign(fileBytes / 4, static_cast<char>('a' + i % 26));
+    }
+    return records;
+}
+
+bool report(SQLHDBC dbc, const char* name, const RunResult& result, size_t records) {
+    long long rows = 0;
+    long long bytes = 0;
+    countRows(dbc, rows, bytes);
+    std::printf("%-28s %8.2f s  %8zu written  %8lld rows  %10.0f records/s  %8.1f MB/s\n",
+        name, result.seconds, result.written, rows, result.written / result.seconds, bytes / result.seconds / (1024 * 1024));
+    executeDirect(dbc, L"TRUNCATE TABLE #data;");
+    return result.written == records && rows == static_cast<long long>(records);
+}
+
+} // namespace
+
+int wmain(int argc, wchar_t* argv[]) {
+    const std::wstring connection = argc > 1 ? argv[1] : DEFAULT_CONNECTION;
+    const size_t count = argc > 2 ? std::stoul(argv[2]) : 2000;
+    const size_t batchSize = argc > 3 ? (std::max<size_t>)(1, std::stoul(argv[3])) : 100;
+    const size_t fileBytes = (argc > 4 ? std::stoul(argv[4]) : 16) * 1024;
+
+    SQLHENV env = SQL_NULL_HENV;
+    SQLHDBC dbc = SQL_NULL_HDBC;
+    SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &env);
+    SQLSetEnvAttr(env, SQL_ATTR_ODBC_VERSION, (SQLPOINTER)SQL_OV_ODBC3, 0);
+    SQLAllocHandle(SQL_HANDLE_DBC, env, &dbc);
+    SQLRETURN ret = SQLDriverConnect(dbc, NULL, (SQLWCHAR*)connection.c_str(), SQL_NTS, nullptr, 0, nullptr, SQL_DRIVER_NOPROMPT);
+    if (!SQL_SUCCEEDED(ret)) {
+        printSQLError("Database connection failed", dbc, SQL_HANDLE_DBC);
+        return 1;
+    }
+
+    // The columns the inserts fill, of the types they have in [data]
+    if (!executeDirect(dbc, LR"(
+        CREATE TABLE #data (
+            [id] INT IDENTITY(1, 1) PRIMARY KEY,
+            [struct_id] INT,
+            [date] DATE,
+            [time] TIME(3),
+            [file_num] NVARCHAR(255),
+            [data_file] VARBINARY(MAX),
+            [express_file] VARBINARY(MAX));
+    )")) {
+        return 1;
+    }
+
+    std::vector<Record> records = generateRecords(count, fileBytes);
+    std::printf("%zu records, batches of %zu, %zu KB RECON and %zu KB REXPR\n",
+        count, batchSize, fileBytes / 1024, fileBytes / 4096);
+
+    // The first round warms the buffer pool and the log, the second one is comparable between the modes
+    bool consistent = true;
+    for (int round = 1; round <= 2; ++round) {
+        std::printf("Round %d\n", round);
+        consistent &= report(dbc, "Row by row", runSingleRows(dbc, records), count);
+        consistent &= report(dbc, "Batches, generated ids", runBatches(dbc, records, batchSize, false), count);
+        consistent &= report(dbc, "Batches, allocated ids", runBatches(dbc, records, batchSize, true), count);
+    }
+
+    SQLDisconnect(dbc);
+    SQLFreeHandle(SQL_HANDLE_DBC, dbc);
+    SQLFreeHandle(SQL_HANDLE_ENV, env);
+    if (!consistent) {
+        std::printf("Some records were not written\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,137 @@
+// Benchmark of the first-launch walk of the recorder tree: the former collectRootPaths walk
+// against DirectoryScanner.
+// Usage: directory_scanner_bench <tree folder> [files = 1000000] [threads = 4]
+// The tree is generated on the first run and reused afterwards. Every object folder holds
+// files of its own and YYYY_MM subfolders, the layout the former walk visited repeatedly
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unordered_set>
+#include "directory_scanner.h"
+
+namespace {
+
+const size_t UNITS = 10;
+const size_t SUBSTATIONS = 10;
+const size_t OBJECTS = 10;
+const size_t MONTHS = 12;
+
+struct WalkResult {
+    size_t visited = 0;     // Files handed to integration, repeats included
+    size_t unique = 0;
+    double seconds = 0;
+};
+
+std::wstring fileName(const wchar_t* prefix, size_t number) {
+    wchar_t name[16];
+    swprintf(name, 16, L"%ls%03zu.%03zu", prefix, (number / 1000) % 1000, number % 1000);
+    return name;
+}
+
+// unit/substation/object with files, and object/YYYY_MM with the rest of them
+void generateTree(const fs::path& root, size_t files) {
+    // Kept in Cache, which both walks skip
+    const fs::path completeMarker = root / L"Cache" / L"tree.complete";
+    if (fs::exists(completeMarker)) {
+        return;
+    }
+
+    const size_t objects = UNITS * SUBSTATIONS * OBJECTS;
+    const size_t perFolder = files / (objects * (MONTHS + 1)) + 1;
+    size_t created = 0;
+    for (size_t u = 0; u < UNITS; ++u) {
+        for (size_t s = 0; s < SUBSTATIONS; ++s) {
+            for (size_t o = 0; o < OBJECTS; ++o) {
+                fs::path object = root / (L"Unit" + std::to_wstring(u)) / (L"Substation" + std::to_wstring(s)) / (L"Object" + std::to_wstring(o));
+                for (size_t m = 0; m <= MONTHS; ++m) {
+                    fs::path folder = m == 0 ? object : object / (L"2024_" + std::wstring(m < 10 ? L"0" : L"") + std::to_wstring(m));
+                    fs::create_directories(folder);
+                    for (size_t i = 0; i < perFolder && created < files; ++i, ++created) {
+                        std::ofstream((folder / fileName(created % 2 ? L"REXPR" : L"RECON", created)).string());
+                    }
+                }
+            }
+        }
+    }
+    fs::create_directories(completeMarker.parent_path());
+    std::ofstream(completeMarker.string());
+    std::printf("Generated %zu files\n", created);
+}
+
+// collectRootPaths, then a recursive walk under every folder that holds files
+WalkResult formerWalk(const fs::path& root) {
+    WalkResult result;
+    std::unordered_set<std::wstring> seen;
+    auto started = std::chrono::steady_clock::now();
+
+    std::unordered_set<std::wstring> parentFolders;
+    for (auto it = fs::recursive_directory_iterator(root); it != fs::recursive_directory_iterator(); ++it) {
+        if (fs::is_directory(*it)) {
+            continue;
+        }
+        std::wstring path = it->path().parent_path().wstring();
+        if (path.find(L"\\Cache") != std::wstring::npos || path.find(L"/Cache") != std::wstring::npos) {
+            continue;
+        }
+        parentFolders.insert(path);
+    }
+
+    for (const auto& path : parentFolders) {
+        for (const auto& entry : fs::recursive_directory_iterator(path)) {
+            if (fs::is_regular_file(entry.status())) {
+                ++result.visited;
+                seen.insert(entry.path().wstring());
+            }
+        }
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    result.unique = seen.size();
+    return result;
+}
+
+WalkResult scannerWalk(const fs::path& root, size_t threads) {
+    WalkResult result;
+    std::unordered_set<std::wstring> seen;
+    auto started = std::chrono::steady_clock::now();
+
+    DirectoryScanner scanner(threads, { L"Cache" });
+    scanner.scan(root.wstring(), [&](const fs::directory_entry& entry) {
+        ++result.visited;
+        seen.insert(entry.path().wstring());
+        return true;
+        });
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    result.unique = seen.size();
+    return result;
+}
+
+void report(const char* name, const WalkResult& result) {
+    std::printf("%-24s %8.2f s  %10zu files visited  %10zu unique  %10.0f files/s\n",
+        name, result.seconds, result.visited, result.unique, result.unique / result.seconds);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::printf("Usage: directory_scanner_bench <tree folder> [files = 1000000] [threads = 4]\n");
+        return 1;
+    }
+    const fs::path root = argv[1];
+    const size_t files = argc > 2 ? std::stoul(argv[2]) : 1000000;
+    const size_t threads = argc > 3 ? std::stoul(argv[3]) : 4;
+
+    generateTree(root, files);
+
+    // The first round warms the file system cache, the second one is comparable between the walks
+    for (int round = 1; round <= 2; ++round) {
+        std::printf("Round %d\n", round);
+        report("collectRootPaths walk", formerWalk(root));
+        report(("DirectoryScanner x" + std::to_string(threads)).c_str(), scannerWalk(root, threads));
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+// Micro-benchmark of reading the fields of a REXPR file: parseExpressHeader against the former
+// std::wregex reading (tests/express_header_reference.h).
+// Usage: express_header_bench [payload KB = 64] [iterations = 2000]
+// A modern file has its lines at the start, a legacy one only the parameters at the end, which makes
+// the parser go through the whole file
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include "express_header.h"
+#include "express_header_reference.h"
+
+namespace {
+
+// Header lines in CP866
+const char MODERN_HEADER[] =
+    "\x8e\xa1\xea\xa5\xaa\xe2: \x8f\x91 110 \xaa\x82\r\n"                                     // "Объект: ПС 110 кВ"
+    "\x84\xa0\xe2\xa0: 29/07/2024\r\n"                                                        // "Дата: 29/07/2024"
+    "\x82\xe0\xa5\xac\xef \xaf\xe3\xe1\xaa\xa0: 12:30:15.250\r\n"                             // "Время пуска: 12:30:15.250"
+    "\x94\xa0\xaa\xe2\xae\xe0 \xaf\xe3\xe1\xaa\xa0: U< 0.8\r\n"                               // "Фактор пуска: U< 0.8"
+    "\x8f\xae\xa2\xe0\xa5\xa6\xa4\xa5\xad\xa8\xa5 (\xe2\xa8\xaf): AB0\r\n"                    // "Повреждение (тип): AB0"
+    "\x8f\xae\xa2\xe0\xa5\xa6\xa4\xa5\xad\xad\xa0\xef \xab\xa8\xad\xa8\xef, "                 // "Поврежденная линия, "
+    "\xaf\xe0\xa5\xa4\xaf\xae\xab\xae\xa6\xa8\xe2\xa5\xab\xec\xad\xae: \x8b-110\r\n";         // "предположительно: Л-110"
+const char LEGACY_PARAMS[] = "$DP=29/07/2024$TP=12:30:15.250$SF=U<$LF=2$\r\n";
+
+// Samples of the recorder without '$' and marker letters, as the binary part of a file
+std::string payload(size_t size) {
+    std::mt19937 random(3);
+    std::string out(size, '\0');
+    for (auto& c : out) {
+        c = static_cast<char>(random() % 0x80);
+        if (c == '$') {
+            c = ' ';
+        }
+    }
+    return out;
+}
+
+template <class Parse>
+double microseconds(const std::string& content, size_t iterations, Parse parse) {
+    size_t found = 0;
+    auto started = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        ExpressHeader header = parse(content.data(), content.size());
+        found += header.date.size() + header.paramDate.size();
+    }
+    double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count();
+    // Keeps the calls from being optimized away
+    if (found == 0) {
+        std::printf("no date found\n");
+    }
+    return elapsed / iterations;
+}
+
+void compare(const char* name, const std::string& content, size_t iterations) {
+    double parser = microseconds(content, iterations, [](const char* data, size_t size) { return parseExpressHeader(data, size); });
+    double former = microseconds(content, iterations,
+        [](const char* data, size_t size) { return reference::parseExpressHeader(data, size); });
+    std::printf("%-8s %8zu bytes  regex %10.1f us  parser %8.1f us  x%.0f\n", name, content.size(), former, parser, former / parser);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const size_t payloadSize = (argc > 1 ? std::stoul(argv[1]) : 64) * 1024;
+    const size_t iterations = argc > 2 ? std::stoul(argv[2]) : 2000;
+
+    compare("modern", MODERN_HEADER + payload(payloadSize), iterations);
+    compare("legacy", payload(payloadSize) + LEGACY_PARAMS, iterations);
+    return 0;
+}
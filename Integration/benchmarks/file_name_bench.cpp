@@ -0,0 +1,133 @@
+// Benchmark of classifying recorder file names: parseFileName against the former checks of collectInfo
+// (prefix vectors with istarts_with, substr, std::stoi and the OMP_C name pattern).
+// Usage: file_name_bench [names = 1000000] [rounds = 3]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+#include <boost/algorithm/string/predicate.hpp>
+#include "file_name.h"
+
+namespace {
+
+struct Counts {
+    size_t data = 0;
+    size_t express = 0;
+    size_t other = 0;
+    size_t canonical = 0;
+    long long reconSum = 0;
+
+    bool operator==(const Counts& other) const {
+        return data == other.data && express == other.express && this->other == other.other &&
+            canonical == other.canonical && reconSum == other.reconSum;
+    }
+};
+
+// Names of a recorder folder: mostly pairs, some other files, a few foreign ones, both letter cases
+std::vector<std::wstring> generateNames(size_t count) {
+    const wchar_t* prefixes[] = { L"RECON", L"REXPR", L"RECON", L"REXPR", L"recon", L"rexpr", L"RNET", L"RPUSK", L"DAILY", L"DIAGN" };
+    std::mt19937 random(11);
+    std::vector<std::wstring> names;
+    names.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        wchar_t name[32];
+        if (random() % 50 == 0) {
+            swprintf(name, 32, L"report_%zu.txt", i);
+        }
+        else {
+            swprintf(name, 32, L"%ls%03u.%03u", prefixes[random() % 10], static_cast<unsigned>(random() % 1000),
+                static_cast<unsigned>(random() % 1000));
+        }
+        names.push_back(name);
+    }
+    return names;
+}
+
+// The checks collectInfo made before parseFileName
+Counts formerClassify(const std::vector<std::wstring>& names) {
+    static const std::vector<std::wstring> validPrefixes = { L"RNET", L"RPUSK", L"DAILY", L"DIAGN", L"RECON", L"REXPR" };
+    const std::wregex pattern(L"^recon\\d{3}\\.\\d{3}$", std::regex_constants::icase);
+
+    Counts counts;
+    for (const auto& fileName : names) {
+        bool valid = std::any_of(validPrefixes.begin(), validPrefixes.end(),
+            [&](const std::wstring& prefix) { return boost::algorithm::istarts_with(fileName, prefix); });
+        if (!valid) {
+            continue;
+        }
+        std::wstring filePrefix = fileName.substr(0, 5);
+        std::wstring reconNum = fileName.substr(5, 3);
+        if (filePrefix == L"RECON" || filePrefix == L"recon") {
+            ++counts.data;
+            counts.reconSum += std::stoi(reconNum);
+            if (std::regex_match(fileName, pattern)) {
+                ++counts.canonical;
+            }
+        }
+        else if (filePrefix == L"REXPR" || filePrefix == L"rexpr") {
+            ++counts.express;
+            counts.reconSum += std::stoi(reconNum);
+        }
+        else {
+            std::vector<std::wstring> otherPrefixes = { L"RNET", L"RPUSK", L"DAILY", L"DIAGN" };
+            if (std::any_of(otherPrefixes.begin(), otherPrefixes.end(),
+                [&](const std::wstring& prefix) { return fileName.rfind(prefix, 0) == 0; })) {
+                ++counts.other;
+            }
+        }
+    }
+    return counts;
+}
+
+Counts parserClassify(const std::vector<std::wstring>& names) {
+    Counts counts;
+    for (const auto& fileName : names) {
+        FileName name = parseFileName(fileName);
+        if (name.isData()) {
+            ++counts.data;
+            counts.reconSum += name.reconNumber;
+            if (name.canonical) {
+                ++counts.canonical;
+            }
+        }
+        else if (name.isExpress()) {
+            ++counts.express;
+            counts.reconSum += name.reconNumber;
+        }
+        else if (name.isOther()) {
+            ++counts.other;
+        }
+    }
+    return counts;
+}
+
+template <class Classify>
+double nanosecondsPerName(const std::vector<std::wstring>& names, Counts& counts, Classify classify) {
+    auto started = std::chrono::steady_clock::now();
+    counts = classify(names);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() / names.size();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const size_t count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    const int rounds = argc > 2 ? std::stoi(argv[2]) : 3;
+    std::vector<std::wstring> names = generateNames(count);
+
+    for (int round = 1; round <= rounds; ++round) {
+        Counts former, parsed;
+        double formerTime = nanosecondsPerName(names, former, formerClassify);
+        double parserTime = nanosecondsPerName(names, parsed, parserClassify);
+        std::printf("Round %d: %zu names  former %7.1f ns/name  parseFileName %5.1f ns/name  x%.0f  %s\n", round, count,
+            formerTime, parserTime, formerTime / parserTime, former == parsed ? "same results" : "RESULTS DIFFER");
+        if (!(former == parsed)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,405 @@
+// Benchmark of one FTP harvest cycle as the number of recorders grows: FtpHarvester over all servers
+// at once against the servers taken one at a time, as StartFtpModule did before the engine.
+// Usage: ftp_harvester_bench [servers = 64] [files per server = 4] [reply latency ms = 10] [file KB = 16]
+// Every recorder is a local FTP stand-in on 127.0.0.1 that holds its files in memory and delays each
+// reply by the latency, the round trip of a substation link. The former one-at-a-time walk is played by
+// the engine limited to one server and one connection, so it keeps its session pooling and is if
+// anything faster than the walk it replaces
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ftp_harvester.h"
+#include "utils.h"
+
+namespace {
+
+#ifdef _WIN32
+using Socket = SOCKET;
+void closeSocket(Socket s) { closesocket(s); }
+const int SHUTDOWN_BOTH = SD_BOTH;
+const int SEND_FLAGS = 0;
+#else
+using Socket = int;
+const Socket INVALID_SOCKET = -1;
+void closeSocket(Socket s) { ::close(s); }
+const int SHUTDOWN_BOTH = SHUT_RDWR;
+// A client that hung up must not kill the benchmark with SIGPIPE
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#endif
+
+// Listening socket on a free port of the loopback interface
+Socket listenLocal(unsigned short& port) {
+    Socket s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET) {
+        return s;
+    }
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+    if (bind(s, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(s, 64) != 0 ||
+        getsockname(s, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        closeSocket(s);
+        return INVALID_SOCKET;
+    }
+    port = ntohs(address.sin_port);
+    return s;
+}
+
+bool sendAll(Socket s, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int n = send(s, data.data() + sent, static_cast<int>(data.size() - sent), SEND_FLAGS);
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// FTP server of one recorder: login, EPSV/PASV, NLST, SIZE, MDTM, REST, RETR and DELE on one directory
+class FtpStandIn {
+public:
+    explicit FtpStandIn(int latencyMs) : latency(latencyMs) {
+        listener = listenLocal(listenPort);
+        if (listener != INVALID_SOCKET) {
+            acceptor = std::thread([this] { acceptLoop(); });
+        }
+    }
+
+    ~FtpStandIn() {
+        stopping = true;
+        shutdown(listener, SHUTDOWN_BOTH);
+        closeSocket(listener);
+        if (acceptor.joinable()) {
+            acceptor.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (Socket s : controls) {
+                shutdown(s, SHUTDOWN_BOTH);
+            }
+        }
+        for (auto& session : sessions) {
+            session.join();
+        }
+    }
+
+    bool valid() const { return listener != INVALID_SOCKET; }
+    unsigned short port() const { return listenPort; }
+
+    void fill(const std::vector<std::string>& names, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        files.clear();
+        for (const auto& name : names) {
+            files[name] = std::string(size, static_cast<char>('A' + name.size() % 26));
+        }
+    }
+
+    size_t remaining() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return files.size();
+    }
+
+private:
+    void acceptLoop() {
+        while (!stopping) {
+            Socket control = accept(listener, nullptr, nullptr);
+            if (control == INVALID_SOCKET) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                closeSocket(control);
+                break;
+            }
+            controls.push_back(control);
+            sessions.emplace_back([this, control] { serve(control); });
+        }
+    }
+
+    void reply(Socket control, const std::string& text) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+        sendAll(control, text + "\r\n");
+    }
+
+    bool readLine(Socket control, std::string& pending, std::string& line) {
+        while (true) {
+            size_t end = pending.find("\r\n");
+            if (end != std::string::npos) {
+                line = pending.substr(0, end);
+                pending.erase(0, end + 2);
+                return true;
+            }
+            char buffer[512];
+            int n = recv(control, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                return false;
+            }
+            pending.append(buffer, static_cast<size_t>(n));
+        }
+    }
+
+    // Data of one NLST or RETR over the passive connection
+    void transfer(Socket control, Socket& passive, const std::string& opening, const std::string& data) {
+        if (passive == INVALID_SOCKET) {
+            reply(control, "425 Use EPSV or PASV first");
+            return;
+        }
+        Socket connection = accept(passive, nullptr, nullptr);
+        closeSocket(passive);
+        passive = INVALID_SOCKET;
+        if (connection == INVALID_SOCKET) {
+            reply(control, "425 Cannot open data connection");
+            return;
+        }
+        reply(control, opening);
+        bool sent = sendAll(connection, data);
+        shutdown(connection, SHUTDOWN_BOTH);
+        closeSocket(connection);
+        reply(control, sent ? "226 Transfer complete" : "426 Transfer aborted");
+    }
+
+    bool lookUp(const std::string& name, std::string& content) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = files.find(name);
+        if (it == files.end()) {
+            return false;
+        }
+        content = it->second;
+        return true;
+    }
+
+    void serve(Socket control) {
+        std::string pending, line, content;
+        Socket passive = INVALID_SOCKET;
+        size_t restart = 0;
+        reply(control, "220 Recorder stand-in ready");
+
+        while (readLine(control, pending, line)) {
+            std::string command = line.substr(0, line.find(' '));
+            std::string argument = line.size() > command.size() ? line.substr(command.size() + 1) : std::string();
+            std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+
+            if (command == "USER") reply(control, "331 Password required");
+            else if (command == "PASS") reply(control, "230 Logged in");
+            else if (command == "PWD") reply(control, "257 \"/\" is the current directory");
+            else if (command == "CWD") reply(control, "250 Directory changed");
+            else if (command == "TYPE") reply(control, "200 Type set");
+            else if (command == "EPSV" || command == "PASV") {
+                unsigned short dataPort = 0;
+                if (passive != INVALID_SOCKET) {
+                    closeSocket(passive);
+                }
+                passive = listenLocal(dataPort);
+                if (command == "EPSV") {
+                    reply(control, "229 Entering Extended Passive Mode (|||" + std::to_string(dataPort) + "|)");
+                }
+                else {
+                    reply(control, "227 Entering Passive Mode (127,0,0,1," + std::to_string(dataPort >> 8) + "," +
+                        std::to_string(dataPort & 0xFF) + ")");
+                }
+            }
+            else if (command == "NLST" || command == "LIST") {
+                std::string listing;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    for (const auto& file : files) {
+                        listing += file.first + "\r\n";
+                    }
+                }
+                transfer(control, passive, "150 Here comes the directory listing", listing);
+            }
+            else if (command == "SIZE") {
+                reply(control, lookUp(argument, content) ? "213 " + std::to_string(content.size()) : "550 No such file");
+            }
+            else if (command == "MDTM") {
+                reply(control, lookUp(argument, content) ? "213 20240729123015" : "550 No such file");
+            }
+            else if (command == "REST") {
+                restart = std::stoul(argument);
+                reply(control, "350 Restarting at " + argument);
+            }
+            else if (command == "RETR") {
+                if (!lookUp(argument, content)) {
+                    reply(control, "550 No such file");
+                    continue;
+                }
+                content.erase(0, (std::min)(restart, content.size()));
+                restart = 0;
+                transfer(control, passive, "150 Opening BINARY mode data connection (" + std::to_string(content.size()) + " bytes)", content);
+            }
+            else if (command == "DELE") {
+                std::lock_guard<std::mutex> lock(mutex);
+                bool erased = files.erase(argument) > 0;
+                reply(control, erased ? "250 Deleted" : "550 No such file");
+            }
+            else if (command == "QUIT") {
+                reply(control, "221 Goodbye");
+                break;
+            }
+            else if (command == "NOOP" || command == "OPTS") reply(control, "200 OK");
+            else reply(control, "502 Command not implemented");
+        }
+
+        if (passive != INVALID_SOCKET) {
+            closeSocket(passive);
+        }
+        shutdown(control, SHUTDOWN_BOTH);
+    }
+
+    int latency;
+    Socket listener = INVALID_SOCKET;
+    unsigned short listenPort = 0;
+    std::atomic_bool stopping{ false };
+    std::thread acceptor;
+    std::mutex mutex;
+    std::map<std::string, std::string> files;
+    std::vector<Socket> controls;
+    std::vector<std::thread> sessions;
+};
+
+// Unique names across the recorders, they all land in one Cache folder
+std::vector<std::string> fileNames(size_t server, size_t files) {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < files; ++i) {
+        char name[16];
+        std::snprintf(name, sizeof(name), "%s%03zu.%03zu", i % 2 ? "REXPR" : "RECON", server % 1000, (i / 2) % 1000);
+        names.push_back(name);
+    }
+    return names;
+}
+
+size_t filesIn(const fs::path& folder) {
+    size_t count = 0;
+    for (const auto& entry : fs::directory_iterator(folder)) {
+        if (entry.path().extension() != ".meta") {
+            ++count;
+        }
+    }
+    return count;
+}
+
+struct CycleResult {
+    double seconds = 0;
+    size_t harvested = 0;
+    size_t leftOnServers = 0;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const size_t maxServers = argc > 1 ? std::stoul(argv[1]) : 64;
+    const size_t filesPerServer = argc > 2 ? std::stoul(argv[2]) : 4;
+    const int latencyMs = argc > 3 ? std::stoi(argv[3]) : 10;
+    const size_t fileSize = (argc > 4 ? std::stoul(argv[4]) : 16) * 1024;
+
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    const fs::path cacheFolder = fs::temp_directory_path() / "ftp_harvester_bench";
+    fs::remove_all(cacheFolder);
+    fs::create_directories(cacheFolder);
+
+    std::vector<std::unique_ptr<FtpStandIn>> standIns;
+    std::vector<ServerInfo> servers;
+    for (size_t i = 0; i < maxServers; ++i) {
+        standIns.push_back(std::make_unique<FtpStandIn>(latencyMs));
+        if (!standIns.back()->valid()) {
+            std::printf("Failed to start FTP stand-in %zu\n", i);
+            return 1;
+        }
+        ServerInfo server;
+        server.unit = L"Unit";
+        server.substation = L"Substation" + std::to_wstring(i);
+        server.object = L"Object";
+        server.ip = L"127.0.0.1:" + std::to_wstring(standIns.back()->port());
+        server.login = L"recon";
+        server.pass = L"recon";
+        server.remoteFolderPath = L"RECORDS";
+        server.localFolderPath = (cacheFolder / "sorted").wstring();
+        server.reconId = static_cast<int>(i);
+        server.lastPingTime = 0;
+        servers.push_back(server);
+    }
+
+    std::atomic_bool ftpIsActive{ true };
+    std::atomic_bool oneDriveIsActive{ false };
+
+    // One pass over the first count servers, by the engine or one server at a time
+    auto cycle = [&](size_t count, bool concurrent) {
+        for (size_t i = 0; i < count; ++i) {
+            standIns[i]->fill(fileNames(i, filesPerServer), fileSize);
+        }
+
+        CycleResult result;
+        auto started = std::chrono::steady_clock::now();
+        if (concurrent) {
+            FtpHarvester harvester(FtpEngineConfig(), L"", cacheFolder.wstring(), ftpIsActive, oneDriveIsActive);
+            harvester.run(std::vector<ServerInfo>(servers.begin(), servers.begin() + count));
+        }
+        else {
+            FtpEngineConfig config;
+            config.maxConnections = 1;
+            config.maxPerServer = 1;
+            for (size_t i = 0; i < count; ++i) {
+                FtpHarvester harvester(config, L"", cacheFolder.wstring(), ftpIsActive, oneDriveIsActive);
+                harvester.run({ servers[i] });
+            }
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        result.harvested = filesIn(cacheFolder);
+        for (size_t i = 0; i < count; ++i) {
+            result.leftOnServers += standIns[i]->remaining();
+        }
+        fs::remove_all(cacheFolder);
+        fs::create_directories(cacheFolder);
+        return result;
+    };
+
+    std::printf("%zu files of %zu KB per recorder, %d ms per reply\n", filesPerServer, fileSize / 1024, latencyMs);
+    std::vector<size_t> counts;
+    for (size_t count = 1; count < maxServers; count *= 4) {
+        counts.push_back(count);
+    }
+    counts.push_back(maxServers);
+
+    bool complete = true;
+    for (size_t count : counts) {
+        CycleResult former = cycle(count, false);
+        CycleResult engine = cycle(count, true);
+        std::printf("%4zu servers  one at a time %8.2f s  FtpHarvester %7.2f s  x%-5.1f  harvested %zu/%zu, left %zu/%zu\n",
+            count, former.seconds, engine.seconds, former.seconds / engine.seconds,
+            former.harvested, engine.harvested, former.leftOnServers, engine.leftOnServers);
+        complete = complete && former.harvested == count * filesPerServer && engine.harvested == count * filesPerServer &&
+            former.leftOnServers == 0 && engine.leftOnServers == 0;
+    }
+
+    standIns.clear();
+    fs::remove_all(cacheFolder);
+    curl_global_cleanup();
+    return complete ? 0 : 1;
+}
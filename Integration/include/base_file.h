@@ -15,8 +15,9 @@ struct BaseFile {
     std::wstring fileName;              // File name
     std::wstring parentFolderPath;		// The folder where the file is located
     std::wstring fullPath;              // Full path to file include file name 
-    std::string binaryData;			 	// Binary data
-    size_t binaryDataSize;              // Size of file
+    std::string binaryData;			 	// Binary data, empty while the content is left on disk
+    size_t binaryDataSize = 0;          // Size of file
+    bool contentOnDisk = false;         // Content is streamed from fullPath when it is written to the database
     std::wstring fileNum;               // Num of file (xxxxx.xxx.321)
 	std::wstring filePrefix;            // Prefix of file (RECON, REXPR, etc.)
 
@@ -35,13 +36,25 @@ struct BaseFile {
     // Reading a file in binary format (need fullPath)
     std::string readFileContent();
 
+    // Taking only the size of the file, its content is uploaded in chunks later (need fullPath)
+    bool statFileContent();
+
+    // Reading a content left on disk into binaryData
+    bool loadContent();
+
+    // Whether there is a content to upload
+    bool hasContent() const { return !binaryData.empty() || (contentOnDisk && binaryDataSize > 0); }
+
+    // Size of the content to upload
+    size_t contentSize() const { return !binaryData.empty() ? binaryData.size() : (contentOnDisk ? binaryDataSize : 0); }
+
     void processPath(std::wstring rootFolder);
     bool getFileDateAndTime();
 
     // Virtual function for file processing
     virtual void processFile() {
         getFileDateAndTime();
-        binaryData = readFileContent();
+        statFileContent();
 
     };
 
@@ -55,12 +68,14 @@ struct ExpressFile : public BaseFile {
 
     bool hasExpressFile = false;
 
-    void readDataFromFile();
+    // Date, time and fault fields from the leading text of the file (need fullPath).
+    // The file is mapped and only the pages the parser reaches are read, the content stays on disk until it is written
+    bool readMetadata();
 
     // Specific handling for ExpressFile
     void processFile() override {
         hasExpressFile = true;
-        readDataFromFile();
+        readMetadata();
     }
 };
 
@@ -71,7 +86,7 @@ struct DataFile : public BaseFile {
     // Specific handling for DataFile
     void processFile() override {
         hasDataFile = true;
-        binaryData = readFileContent();
+        statFileContent();
         getFileDateAndTime();
     }
 };
@@ -0,0 +1,104 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Thread-safe FIFO with a fixed capacity.
+// Producers block (or fail with tryPush) while it is full, consumers block until an item arrives
+// or the queue is closed and drained.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity ? capacity : 1) {}
+
+    // prohibit copying
+    BoundedQueue(const BoundedQueue&) = delete;
+    void operator=(const BoundedQueue&) = delete;
+
+    // Waiting for free space, false if the queue was closed meanwhile
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Adding without waiting, false if the queue is full or closed
+    bool tryPush(T item) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed || items.size() >= capacity) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Waiting for an item, false once the queue is closed and empty
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Waiting for an item at most the given time
+    template <typename Rep, typename Period>
+    bool popFor(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!notEmpty.wait_for(lock, timeout, [this] { return closed || !items.empty(); }) || items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Taking an item without waiting
+    bool tryPop(T& item) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // No more items will be pushed, waiting consumers drain the rest and stop
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+
+private:
+    const size_t capacity;
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    bool closed = false;
+};
+
+#endif // BOUNDED_QUEUE_H
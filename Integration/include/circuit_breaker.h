@@ -0,0 +1,54 @@
+#ifndef CIRCUIT_BREAKER_H
+#define CIRCUIT_BREAKER_H
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+
+// Breaker state of one recorder
+enum class BreakerState { Closed, Open, HalfOpen };
+
+// Per-recorder circuit breaker with jittered exponential backoff.
+// After several failures in a row the recorder is not contacted until its backoff expires,
+// then a single trial decides whether it is closed again or the backoff doubles.
+class CircuitBreaker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Failures in a row before opening, first backoff and its upper bound
+    void configure(int failureThreshold, std::chrono::seconds baseBackoff, std::chrono::seconds maxBackoff);
+
+    // Whether the recorder may be contacted now, an expired open breaker becomes half-open
+    bool allowRequest(const std::string& key);
+
+    void recordSuccess(const std::string& key);
+    void recordFailure(const std::string& key);
+
+    BreakerState state(const std::string& key) const;
+
+    // Publishing the number of recorders in each state as gauges
+    void exportMetrics() const;
+
+private:
+    struct Entry {
+        BreakerState state = BreakerState::Closed;
+        int consecutiveFailures = 0;
+        int openCount = 0;              // Openings since the last success, the exponent of the backoff
+        Clock::time_point retryAt;
+    };
+
+    // Backoff for the given opening with "equal jitter": half fixed, half random
+    std::chrono::milliseconds nextBackoff(int openCount);
+
+    mutable std::mutex mutex;
+    std::map<std::string, Entry> entries;
+    std::mt19937 random{ std::random_device{}() };
+
+    int failureThreshold = 3;
+    std::chrono::seconds baseBackoff{ 60 };
+    std::chrono::seconds maxBackoff{ 6 * 60 * 60 };
+};
+
+#endif // CIRCUIT_BREAKER_H
@@ -0,0 +1,25 @@
+#ifndef CP866_DECODER_H
+#define CP866_DECODER_H
+
+#include <cstddef>
+#include <string>
+
+// CP866 text of the recorders decoded without iconv. The upper half of the code page is looked up
+// in a table, runs of ASCII are copied 16 bytes at a time
+class Cp866Decoder {
+public:
+    // Decoder of the calling thread, its output buffers are reused from call to call
+    static Cp866Decoder& forThisThread();
+
+    // The result stays valid until the next call of the same method on this thread
+    const std::wstring& toWide(const char* data, size_t size);
+    const std::string& toUtf8(const char* data, size_t size);
+
+private:
+    Cp866Decoder() {}
+
+    std::wstring wide;
+    std::string utf8;
+};
+
+#endif // CP866_DECODER_H
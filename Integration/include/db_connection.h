@@ -18,6 +18,7 @@
 #include <set>
 #include <map>
 #include <algorithm>
+#include <atomic>
 #include <string>
 #include <sstream>
 #include <fstream>
@@ -53,6 +54,19 @@ public:
 	// Getting config string in Json format
 	static std::wstring getJsonConfigFromDatabase(std::string name, SQLHDBC dbc);
 
+	// Creating or updating the stored procedures of the application, every step can run again safely
+	static bool applyMigrations(SQLHDBC dbc);
+
+	// Whether integrate_file_record can be called instead of the separate statements
+	static bool hasUpsertProcedure() {
+		return upsertProcedureReady;
+	}
+
+	// The procedure turned out to be missing, records go through the separate statements again
+	static void disableUpsertProcedure() {
+		upsertProcedureReady = false;
+	}
+
 	// Checking if the database is connected
 	bool isConnected();
 
@@ -75,6 +89,8 @@ private:
 	std::string findConfigFile();
 
 	static std::wstring configFileName;
+
+	static std::atomic_bool upsertProcedureReady;
 };
 
 
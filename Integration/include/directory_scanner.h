@@ -0,0 +1,63 @@
+#ifndef DIRECTORY_SCANNER_H
+#define DIRECTORY_SCANNER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "bounded_queue.h"
+
+namespace fs = boost::filesystem;
+
+// Walks a directory tree exactly once. Directories are listed in parallel by a pool of threads,
+// every regular file is handed to the visitor once, on the thread that called scan()
+class DirectoryScanner {
+public:
+    // Returning false stops the scan
+    using Visitor = std::function<bool(const fs::directory_entry& entry)>;
+
+    // Directories with one of the skipped names are not entered (e.g. the FTP "Cache" folder)
+    explicit DirectoryScanner(size_t threads, std::vector<std::wstring> skippedNames = {});
+
+    // prohibit copying
+    DirectoryScanner(const DirectoryScanner&) = delete;
+    void operator=(const DirectoryScanner&) = delete;
+
+    // Number of files handed to the visitor, stops early once the visitor returns false
+    size_t scan(const std::wstring& rootFolder, const Visitor& visitor);
+
+private:
+    // Listing directories until the tree is exhausted or the scan is stopped
+    void listDirectories();
+
+    // Queues a directory unless the same directory was already reached by another path
+    void enqueueDirectory(const fs::path& path);
+
+    bool isSkipped(const fs::path& path) const;
+
+    // Ends the scan early, listing threads leave after their current directory
+    void stop();
+
+    // Files found by the listing threads waiting for the visitor
+    static constexpr size_t fileQueueCapacity = 4096;
+
+    const size_t threads;
+    const std::vector<std::wstring> skippedNames;
+
+    std::mutex mutex;
+    std::condition_variable directoryReady;
+    std::deque<fs::path> directories;
+    std::unordered_set<std::wstring> visited;       // Canonical paths, junctions and links are entered once
+    size_t outstanding = 0;                         // Directories queued or being listed
+    std::atomic_bool stopped{ false };
+    std::atomic<size_t> runningThreads{ 0 };
+    std::atomic<size_t> listedDirectories{ 0 };
+    BoundedQueue<fs::directory_entry>* files = nullptr;
+};
+
+#endif // DIRECTORY_SCANNER_H
@@ -0,0 +1,31 @@
+#ifndef EXPRESS_HEADER_H
+#define EXPRESS_HEADER_H
+
+#include <cstddef>
+#include <string>
+
+// Fields of the text of a REXPR file. Empty if the file has no such line
+struct ExpressHeader {
+    std::wstring date;              // ": 29/07/2024"
+    std::wstring time;              // " : 12:30:15.250"
+    std::wstring factor;            // " : ..."
+    std::wstring typeKz;            // " ...: ..."
+    std::wstring damagedLine;       // " , : ..."
+
+    // Parameters of older recorders, the last occurrence counts: $DP=date$TP=time$SF=factor$LF=phases
+    std::wstring paramDate;
+    std::wstring paramTime;
+    std::wstring paramFactor;
+    std::wstring paramLineFault;
+};
+
+// Parsing the CP866 contents of a REXPR file in one pass, without regular expressions.
+// Gives the same values as the former std::wregex patterns: the first matching line of each field,
+// a value runs to the end of its line and may start on the next one if the marker ends a line
+ExpressHeader parseExpressHeader(const char* data, size_t size);
+
+inline ExpressHeader parseExpressHeader(const std::string& content) {
+    return parseExpressHeader(content.data(), content.size());
+}
+
+#endif // EXPRESS_HEADER_H
@@ -0,0 +1,69 @@
+#ifndef FILE_CATALOG_H
+#define FILE_CATALOG_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+const std::string FILE_CATALOG_PATH = "FileCatalog.log";
+
+// Local catalog of integrated files: path, size, modification time and SHA-256 of the contents.
+// A scan skips files that were integrated and did not change since, so an interrupted first launch
+// resumes where it stopped. Kept as an append-only log next to the executable, read into memory on load
+class FileCatalog {
+public:
+    static FileCatalog& getInstance() {
+        static FileCatalog instance;
+        return instance;
+    }
+
+    // prohibit copying
+    FileCatalog(const FileCatalog&) = delete;
+    void operator=(const FileCatalog&) = delete;
+
+    // Reading the log, superseded lines are compacted away
+    void load(const std::string& logPath = FILE_CATALOG_PATH);
+
+    // Whether the file was integrated and is unchanged. With equal size but another time
+    // the contents decide, a file only touched is not integrated again
+    bool isIntegrated(const fs::directory_entry& entry);
+
+    // The file at its final location was integrated. Visible at once, durable after commit()
+    void markIntegrated(const std::wstring& path);
+
+    // Appending the marks since the last commit to the log
+    void commit();
+
+    // Forgetting every file, the database was emptied
+    void clear();
+
+private:
+    FileCatalog() {}
+
+    struct Entry {
+        uint64_t size = 0;
+        int64_t modified = 0;
+        std::string hash;               // SHA-256, hex
+    };
+
+    static std::wstring keyOf(const fs::path& path);
+    static std::string hashFile(const std::wstring& path);
+    static std::string formatLine(const std::wstring& key, const Entry& entry);
+    static bool parseLine(const std::string& line, std::wstring& key, Entry& entry);
+
+    // Rewriting the log with one line per file
+    void compact();
+
+    std::mutex mutex;
+    std::string logPath = FILE_CATALOG_PATH;
+    std::unordered_map<std::wstring, Entry> entries;
+    std::vector<std::string> uncommitted;
+    size_t logLines = 0;
+};
+
+#endif // FILE_CATALOG_H
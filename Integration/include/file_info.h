@@ -13,6 +13,7 @@ struct FileInfo {
     bool hasExpressFile = false;
     bool hasDataFile = false;
     bool hasOtherTypeFile = false;
+    std::wstring stagingFolder;     // Folder the files wait in (Cache) until they are moved to parentFolderPath
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,155 @@
+#ifndef FILE_NAME_H
+#define FILE_NAME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Kinds of recorder files, told apart by the first letters of the name
+enum class FilePrefix : uint8_t {
+    None,
+    Recon,  // data file
+    Rexpr,  // express file
+    Rnet,
+    Rpusk,
+    Daily,
+    Diagn
+};
+
+// Name of a recorder file decoded once, ex. RECON167.759
+struct FileName {
+    FilePrefix prefix = FilePrefix::None;
+    int reconNumber = -1;       // Leading digits of characters 5-7, -1 if there are none
+    int fileNumber = -1;        // Leading digits of characters 9-11, -1 if there are none
+    bool canonical = false;     // Exactly five letters, three digits, a dot and three digits
+
+    constexpr bool valid() const { return prefix != FilePrefix::None; }
+    constexpr bool isData() const { return prefix == FilePrefix::Recon; }
+    constexpr bool isExpress() const { return prefix == FilePrefix::Rexpr; }
+    constexpr bool isOther() const { return valid() && !isData() && !isExpress(); }
+
+    // Same for a RECON file and its REXPR pair, -1 for names not in the canonical form
+    constexpr int pairKey() const { return canonical ? reconNumber * 1000 + fileNumber : -1; }
+
+    std::wstring prefixText() const;        // RECON, in capitals whatever the case of the name
+    std::wstring fileNumberText() const;    // 759, empty if there is no file number
+    std::wstring pairName() const;          // REXPR167.759 for RECON167.759 and back, empty for the rest
+};
+
+namespace fileNameDetail {
+
+struct PrefixText {
+    FilePrefix prefix;
+    const char* text;
+    size_t length;
+};
+
+constexpr PrefixText PREFIXES[] = {
+    { FilePrefix::Recon, "RECON", 5 },
+    { FilePrefix::Rexpr, "REXPR", 5 },
+    { FilePrefix::Rnet, "RNET", 4 },
+    { FilePrefix::Rpusk, "RPUSK", 5 },
+    { FilePrefix::Daily, "DAILY", 5 },
+    { FilePrefix::Diagn, "DIAGN", 5 },
+};
+
+template <typename Char>
+constexpr bool isDigit(Char c) {
+    return c >= Char('0') && c <= Char('9');
+}
+
+// The recorders write prefixes either in capitals or in small letters, never mixed
+template <typename Char>
+constexpr bool startsWith(std::basic_string_view<Char> name, const PrefixText& prefix) {
+    if (name.size() < prefix.length) {
+        return false;
+    }
+    bool upper = true;
+    bool lower = true;
+    for (size_t i = 0; i < prefix.length; ++i) {
+        Char letter = Char(prefix.text[i]);
+        upper = upper && name[i] == letter;
+        lower = lower && name[i] == Char(letter + ('a' - 'A'));
+    }
+    return upper || lower;
+}
+
+template <typename Char>
+constexpr int leadingNumber(std::basic_string_view<Char> name, size_t pos, size_t count) {
+    if (pos >= name.size() || !isDigit(name[pos])) {
+        return -1;
+    }
+    int value = 0;
+    for (size_t i = pos; i < name.size() && i < pos + count && isDigit(name[i]); ++i) {
+        value = value * 10 + static_cast<int>(name[i] - Char('0'));
+    }
+    return value;
+}
+
+} // namespace fileNameDetail
+
+// Decoding a file name without allocating, usable at compile time
+template <typename Char>
+constexpr FileName parseFileName(std::basic_string_view<Char> name) {
+    FileName result;
+    for (const auto& prefix : fileNameDetail::PREFIXES) {
+        if (fileNameDetail::startsWith(name, prefix)) {
+            result.prefix = prefix.prefix;
+            break;
+        }
+    }
+    if (!result.valid()) {
+        return result;
+    }
+
+    result.reconNumber = fileNameDetail::leadingNumber(name, 5, 3);
+    result.fileNumber = fileNameDetail::leadingNumber(name, 9, 3);
+
+    bool canonical = name.size() == 12 && result.prefix != FilePrefix::Rnet && name[8] == Char('.');
+    for (size_t i : { 5, 6, 7, 9, 10, 11 }) {
+        canonical = canonical && fileNameDetail::isDigit(name[i]);
+    }
+    result.canonical = canonical;
+    return result;
+}
+
+inline std::wstring FileName::prefixText() const {
+    for (const auto& text : fileNameDetail::PREFIXES) {
+        if (text.prefix == prefix) {
+            return std::wstring(text.text, text.text + text.length);
+        }
+    }
+    return std::wstring();
+}
+
+inline std::wstring FileName::fileNumberText() const {
+    if (fileNumber < 0) {
+        return std::wstring();
+    }
+    return std::to_wstring(1000 + fileNumber).substr(1);
+}
+
+inline std::wstring FileName::pairName() const {
+    if (!canonical || (!isData() && !isExpress())) {
+        return std::wstring();
+    }
+    std::wstring pairPrefix = isData() ? L"REXPR" : L"RECON";
+    return pairPrefix + std::to_wstring(1000 + reconNumber).substr(1) + L"." + fileNumberText();
+}
+
+inline FileName parseFileName(const std::wstring& name) {
+    return parseFileName(std::wstring_view(name));
+}
+
+inline FileName parseFileName(const std::string& name) {
+    return parseFileName(std::string_view(name));
+}
+
+static_assert(parseFileName(std::wstring_view(L"RECON167.759")).pairKey() == 167759, "data file");
+static_assert(parseFileName(std::string_view("rexpr167.759")).isExpress(), "express file in small letters");
+static_assert(!parseFileName(std::wstring_view(L"Recon167.759")).valid(), "mixed case prefix");
+static_assert(parseFileName(std::string_view("RNET012.345")).isOther(), "other file");
+static_assert(parseFileName(std::wstring_view(L"RECON16a.759")).pairKey() == -1, "letters in the numbers");
+
+#endif // FILE_NAME_H
@@ -0,0 +1,40 @@
+#ifndef FILE_VIEW_H
+#define FILE_VIEW_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only view of a whole file mapped into memory (MapViewOfFile, mmap elsewhere).
+// The bytes are read by the page faults of whoever looks at them, nothing is copied into a buffer.
+// The file stays readable, renamable and deletable by others while it is mapped, writers are refused.
+// Files on network shares and removable drives are read into memory instead: a page of theirs that
+// fails to come in raises EXCEPTION_IN_PAGE_ERROR in the reader, which no C++ handler catches
+class FileView {
+public:
+    FileView() {}
+    explicit FileView(const std::wstring& path) { open(path); }
+    ~FileView() { close(); }
+
+    // prohibit copying
+    FileView(const FileView&) = delete;
+    void operator=(const FileView&) = delete;
+
+    FileView(FileView&& other) noexcept;
+    FileView& operator=(FileView&& other) noexcept;
+
+    // Mapping or reading the file, false if it cannot be opened or read or is empty
+    bool open(const std::wstring& path);
+    void close();
+
+    bool valid() const { return begin != nullptr; }
+    const char* data() const { return begin; }
+    size_t size() const { return length; }
+
+private:
+    const char* begin = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    std::string buffer;         // Contents of a file that is not mapped
+};
+
+#endif // FILE_VIEW_H
@@ -12,9 +12,18 @@
 #include <sys/stat.h>
 #include <sys/utime.h>  
 #include <map>
+#include <cstring>
+#include "ftp_session.h"
+#include "circuit_breaker.h"
+#include "poll_scheduler.h"
 
 namespace fs = boost::filesystem;
 
+// Suffix of a download in progress, the Cache consumer never touches such files
+const std::wstring FTP_PARTIAL_SUFFIX = L".part";
+
+struct HarvestedFile;
+
 // Structure for storing server information
 struct ServerInfo {
     std::wstring unit;
@@ -28,22 +37,49 @@ struct ServerInfo {
     int status = 0;
     int reconId = 0;
     std::time_t lastPingTime;
+    long connectLatencyMs = -1;      // Measured by the reachability probe
 };
 
-// Structure for transferring context information during FTP operations
-struct FtpTransferContext {
-    const ServerInfo* server;
-    std::string url;
-    std::wstring oneDrivePath;
-    std::atomic_bool* ftpIsActive;
-    std::atomic_bool* oneDriveIsActive;
-    SQLHDBC dbc;
-    std::wstring ftpCacheDirPath;
-
-    std::atomic<size_t> processedFiles{ 0 };
-    size_t maxFilesPerSession = 500;
+// Splitting a listing stream into lines, a line cut between two chunks is kept until its end arrives
+class LineAssembler {
+public:
+    template <typename OnLine>
+    void feed(const char* data, size_t size, OnLine&& onLine) {
+        size_t start = 0;
+        while (start < size) {
+            const char* end = static_cast<const char*>(memchr(data + start, '\n', size - start));
+            if (!end) {
+                partial.append(data + start, size - start);
+                return;
+            }
+            partial.append(data + start, end - (data + start));
+            start = (end - data) + 1;
+            emit(onLine);
+        }
+    }
+
+    // The last line of a listing may come without a line break
+    template <typename OnLine>
+    void finish(OnLine&& onLine) {
+        emit(onLine);
+    }
+
+private:
+    template <typename OnLine>
+    void emit(OnLine& onLine) {
+        partial.erase(partial.find_last_not_of("\r\n") + 1);
+        if (!partial.empty()) {
+            onLine(partial);
+        }
+        partial.clear();
+    }
+
+    std::string partial;
 };
 
+// Checking that a remote file name has one of the harvested prefixes
+bool startsWithValidPrefix(const std::string& fileName);
+
 class Ftp {
 public:
     static Ftp& getInstance() {
@@ -67,23 +103,45 @@ public:
 	// Writing data to a file
     static size_t write_data(void* ptr, size_t size, size_t nmemb, FILE* stream);
 
-    // Function for working with ftp file
-    static size_t write_list_stream(void* buffer, size_t size, size_t nmemb, void* userp);
+	// Writing the ".meta" sidecar with the target folder of a downloaded file, it appears atomically
+    bool writeMetaFile(const std::string& fileName, const ServerInfo& server, const std::wstring& ftpCacheDirPath);
+
+	// Copying a downloaded file (sourceFile) into the OneDrive folder tree of the server
+    void copyToOneDrive(const std::string& fileName, const ServerInfo& server, const std::wstring& oneDrivePath, const std::wstring& sourceFile);
+
+	// Path of the download in progress of a remote file
+    static std::wstring partialPath(const std::string& fileName, const std::wstring& ftpCacheDirPath);
 
-	// Processing a single file
-    void processSingleFile(const std::string& fileName, FtpTransferContext& context);
+	// Size of the partial download left by an interrupted transfer, 0 if there is none
+    static uintmax_t partialSize(const std::wstring& partPath);
 
-	// Collect ftp servers from the database
-    void collectServers(std::vector<ServerInfo>& servers, SQLHDBC dbc);
+	// Keeping a failed download for resumption, unless nothing usable was received
+    static void keepPartial(const std::wstring& partPath, CURLcode result);
 
-	// Method to set time for files
-    void setFileTime(const std::string& filePath, const std::string& timestamp);
+	// Comparing a finished download with the size reported by the server, a mismatch is discarded
+    static bool verifyDownloadSize(const std::wstring& partPath, const FtpSession& session);
 
-	// Downloads a file from the server
-    bool downloadFile(const std::string& fileName, const ServerInfo& server, const std::string url, const std::wstring& ftpCacheDirPath);
+	// Removing ".part" files no transfer has touched for maxAge
+    static void removeStalePartials(const std::wstring& ftpCacheDirPath, std::chrono::seconds maxAge);
 
-	// Deletes a file from the server
-    int deleteFile(const std::string& filename, const ServerInfo& server, const std::string& url);
+	// Publishing a complete download: the sidecar first, then the data file is renamed from its ".part" name
+    bool publishDownload(const std::string& fileName, const ServerInfo& server, const std::wstring& ftpCacheDirPath);
+
+	// Writing a memory buffer into a new file
+    static bool writeBufferToFile(const std::wstring& filePath, const std::string& data);
+
+	// Storing a file handed over in memory at its final location, or in Cache with a sidecar if that fails.
+	// Returns the stored path, empty if the file could not be stored at all
+    std::wstring storeHarvestedFile(const HarvestedFile& file, const std::wstring& ftpCacheDirPath, bool& storedInCache);
+
+	// Collect ftp servers from the database, only the reachable ones are returned
+    void collectServers(std::vector<ServerInfo>& servers, SQLHDBC dbc, long probeDeadlineMs = 5000);
+
+	// Checks all servers at once, unreachable ones are removed from the vector
+    void probeServers(std::vector<ServerInfo>& servers, long deadlineMs);
+
+	// Method to set the modification time (UTC seconds) of a downloaded file
+    void setFileTime(const std::wstring& filePath, std::time_t modificationTime);
 
 	// Checks if the server is reachable
     bool checkConnection(const std::string& url, const std::string login, const std::string pass);
@@ -94,9 +152,6 @@ public:
 	// Creates a local directory tree based on server information
     void createLocalDirectoryTree(ServerInfo& server, std::string rootFolder);
 
-	// Transferring files from the server
-    void fileTransfer(const ServerInfo& server, const std::string& url, const std::wstring& oneDrivePath, std::atomic_bool& ftpIsActive, std::atomic_bool& oneDriveIsActive, SQLHDBC dbc, const std::wstring& ftpCacheDirPath);
-
 	// Method to save the last ping time for a server
     void pingServer(int serverId, time_t time) {
         serverLastPing[serverId] = time;
@@ -112,6 +167,19 @@ public:
 		return servers;
 	}
 
+	// Breakers of the recorders keyed by IP, kept across feeding cycles
+	CircuitBreaker& circuitBreaker() {
+		return breaker;
+	}
+
+	// Polling schedule of the remote directories, keyed by pollKey()
+	PollScheduler& pollScheduler() {
+		return scheduler;
+	}
+
+	// Key of a remote directory in the polling schedule
+	static std::string pollKey(const ServerInfo& server);
+
 
 
 private:
@@ -123,6 +191,12 @@ private:
    
     // Storing last server pings for Logs table 
     std::map<int, std::time_t> serverLastPing;
+
+    // Backoff state of unreachable recorders
+    CircuitBreaker breaker;
+
+    // Next listing time of every directory
+    PollScheduler scheduler;
 };
 
 #endif // FTP_H
\ No newline at end of file
@@ -0,0 +1,161 @@
+#ifndef FTP_HARVESTER_H
+#define FTP_HARVESTER_H
+
+#include <curl/curl.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ftp_handler.h"
+#include "ftp_session.h"
+#include "ftp_inbox.h"
+
+// Limits of the concurrent FTP harvesting engine ("ftp_engine" in access_settings)
+struct FtpEngineConfig {
+    long maxConnections = 32;           // Global cap of simultaneous transfers
+    long maxPerServer = 2;              // Cap of simultaneous transfers to one recorder (by IP)
+    long connectTimeout = 10;           // Seconds to establish a control connection
+    long probeDeadlineMs = 5000;        // Reachability check of all servers before the pass
+    long breakerThreshold = 3;          // Failed probes in a row before a recorder is left alone
+    long breakerBaseBackoff = 60;       // Seconds of the first backoff, doubled on every reopening
+    long breakerMaxBackoff = 21600;     // Upper bound of the backoff in seconds
+    long pollMinInterval = 10;          // Seconds between two listings of a busy directory
+    long pollMaxInterval = 0;           // Seconds between listings of a quiet one, 0 takes feeding_cycle
+    long listTimeout = 30;              // Seconds for listing one remote directory
+    long transferTimeout = 300;         // Seconds for RETR or DELE of one file
+    size_t maxFilesPerSession = 500;    // Files taken from one directory per pass
+    bool directHandoff = false;         // Downloads go to integration in memory instead of through Cache
+    long handoffTimeout = 120;          // Seconds to wait for integration to persist a handed over file
+    size_t handoffMaxFileSize = 8 * 1024 * 1024; // Bigger downloads are spilled to Cache
+    long partialRetention = 86400;      // Seconds an interrupted download is kept for resumption
+};
+
+// Parsing json string config from database, defaults are kept for missing fields
+FtpEngineConfig parseFtpEngineConfig(const std::string& jsonString);
+
+// Drives LIST, RETR and DELE for many servers at once on the curl multi interface
+class FtpHarvester {
+public:
+    FtpHarvester(const FtpEngineConfig& config,
+        const std::wstring& oneDrivePath,
+        const std::wstring& ftpCacheDirPath,
+        std::atomic_bool& ftpIsActive,
+        std::atomic_bool& oneDriveIsActive,
+        HarvestedFileQueue* inbox = nullptr,
+        const std::atomic_bool* inboxIsDrained = nullptr);
+    ~FtpHarvester();
+
+    // prohibit copying
+    FtpHarvester(const FtpHarvester&) = delete;
+    void operator=(const FtpHarvester&) = delete;
+
+    // One harvest pass over the servers, returns when all of them are done
+    void run(const std::vector<ServerInfo>& servers);
+
+private:
+    enum class Operation { List, Retrieve, Delete };
+
+    // Sessions opened to one recorder with one login, reused by all its directories
+    struct SessionPool {
+        std::vector<std::unique_ptr<FtpSession>> sessions;
+        std::vector<FtpSession*> idle;
+    };
+
+    // State of one remote directory during the pass
+    struct ServerJob {
+        const ServerInfo* server = nullptr;
+        std::string url;                        // Directory URL with trailing slash
+        std::string userPwd;
+        std::string hostKey;                    // Per-server cap is counted by IP
+        SessionPool* pool = nullptr;
+        std::deque<std::string> toRetrieve;
+        std::deque<std::string> toDelete;
+        size_t queuedFiles = 0;
+        int active = 0;
+        bool listStarted = false;
+        bool listFinished = false;
+        bool listSucceeded = false;
+    };
+
+    // One command running on a session attached to the multi handle
+    struct Transfer {
+        FtpSession* session = nullptr;
+        FtpHarvester* harvester = nullptr;
+        Operation operation = Operation::List;
+        ServerJob* job = nullptr;
+        std::string fileName;
+        LineAssembler lines;                    // NLST output, split while it arrives
+        std::wstring localPath;
+        FILE* file = nullptr;
+        curl_off_t resumeFrom = 0;              // Bytes of the ".part" file kept from an interrupted download
+        std::string buffer;                     // Download kept in memory for the direct handoff
+        bool inMemory = false;
+
+        ~Transfer();
+    };
+
+    // File handed to integration, deleted from the recorder once it is persisted
+    struct PendingHandoff {
+        ServerJob* job = nullptr;
+        std::string fileName;
+        std::shared_ptr<HarvestedFile> file;    // Withdrawn from the inbox if not taken in time
+        std::future<bool> persisted;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    // Starting as many transfers as the caps allow
+    void scheduleTransfers();
+
+    // Taking an idle session of the recorder or opening a new one
+    FtpSession* acquireSession(ServerJob& job);
+
+    // Preparing a session for the operation and adding it to the multi handle
+    bool startTransfer(ServerJob& job, Operation operation, const std::string& fileName);
+
+    // Handling a finished easy handle
+    void finishTransfer(Transfer* transfer, CURLcode result);
+
+    void onListFinished(ServerJob& job, Transfer& transfer, CURLcode result);
+
+    // Callback queueing listed files, RETR starts while the listing is still running
+    static size_t onListData(void* buffer, size_t size, size_t nmemb, void* userp);
+    void queueListedFile(ServerJob& job, const std::string& fileName);
+    void onRetrieveFinished(ServerJob& job, Transfer& transfer, CURLcode result);
+
+    // Callback of a download kept in memory, spills to the ".part" file past the size limit
+    static size_t onRetrieveData(void* buffer, size_t size, size_t nmemb, void* userp);
+
+    // Whether integration is taking files from the inbox now, nothing is handed over otherwise
+    bool handoffAvailable() const;
+
+    // Offering the buffered file to integration, false if the inbox is full or not drained
+    bool handOff(ServerJob& job, Transfer& transfer, long filetime);
+
+    // Moving a complete ".part" file to Cache
+    void publishToCache(ServerJob& job, const std::string& fileName, const std::wstring& localPath, long filetime);
+
+    // Queueing DELE for files integration has persisted, withdrawn files are stored in Cache instead
+    void checkHandoffs();
+    void onDeleteFinished(ServerJob& job, Transfer& transfer, CURLcode result);
+
+    FtpEngineConfig config;
+    std::wstring oneDrivePath;
+    std::wstring ftpCacheDirPath;
+    std::atomic_bool& ftpIsActive;
+    std::atomic_bool& oneDriveIsActive;
+    HarvestedFileQueue* inbox = nullptr;
+    const std::atomic_bool* inboxIsDrained = nullptr;
+
+    CURLM* multi = nullptr;
+    std::vector<std::unique_ptr<ServerJob>> jobs;
+    std::map<std::string, SessionPool> sessionPools;
+    std::map<std::string, int> activePerHost;
+    std::vector<PendingHandoff> pendingHandoffs;
+    int activeTotal = 0;
+};
+
+#endif // FTP_HARVESTER_H
@@ -0,0 +1,43 @@
+#ifndef FTP_INBOX_H
+#define FTP_INBOX_H
+
+#include <atomic>
+#include <ctime>
+#include <future>
+#include <memory>
+#include <string>
+#include "bounded_queue.h"
+#include "ftp_handler.h"
+
+// Downloaded file handed from the FTP module straight to integration, without the Cache round trip
+struct HarvestedFile {
+    std::string fileName;
+    ServerInfo server;                  // localFolderPath is the final location of the file
+    std::string data;
+    std::time_t modificationTime = -1;
+    std::wstring oneDrivePath;          // Empty if no OneDrive copy is wanted
+
+    // Set by integration once the file is durable on disk (true) or could not be stored (false).
+    // The FTP module deletes the remote file only after a true
+    std::promise<bool> persisted;
+
+    // Whoever comes first decides: integration takes the file, or FTP withdraws it after the handoff timeout.
+    // A withdrawn file is skipped by integration, FTP stores it in Cache instead
+    bool claim() { return settle(State::Claimed); }
+    bool withdraw() { return settle(State::Withdrawn); }
+
+private:
+    enum class State { Queued, Claimed, Withdrawn };
+
+    bool settle(State outcome) {
+        State expected = State::Queued;
+        return state.compare_exchange_strong(expected, outcome);
+    }
+
+    std::atomic<State> state{ State::Queued };
+};
+
+// In-process queue between the FTP harvester and the integration thread
+using HarvestedFileQueue = BoundedQueue<std::shared_ptr<HarvestedFile>>;
+
+#endif // FTP_INBOX_H
@@ -0,0 +1,56 @@
+#ifndef FTP_SESSION_H
+#define FTP_SESSION_H
+
+#include <curl/curl.h>
+#include <cstdio>
+#include <string>
+
+// One authenticated control connection to a recorder.
+// The easy handle lives for the whole harvest pass, so libcurl keeps the connection
+// and the login and reuses them for every LIST, RETR (with MDTM) and DELE sent through it.
+class FtpSession {
+public:
+    // libcurl write callback receiving a listing or file stream
+    using WriteCallback = size_t(*)(void* buffer, size_t size, size_t nmemb, void* userp);
+
+    FtpSession(const std::string& userPwd, long connectTimeout);
+    ~FtpSession();
+
+    // prohibit copying
+    FtpSession(const FtpSession&) = delete;
+    void operator=(const FtpSession&) = delete;
+
+    bool isValid() const { return curl != nullptr; }
+
+    // Easy handle for the multi interface
+    CURL* handle() const { return curl; }
+
+    // Preparing the handle for one command, the open connection is not touched
+    void prepareList(const std::string& dirUrl, WriteCallback onData, void* userp, long timeout);
+    // A positive resumeFrom continues a partial download with REST, data is appended to the file
+    void prepareRetrieve(const std::string& fileUrl, FILE* file, long timeout, curl_off_t resumeFrom = 0);
+    void prepareRetrieve(const std::string& fileUrl, WriteCallback onData, void* userp, long timeout);
+    void prepareDelete(const std::string& dirUrl, const std::string& fileName, long timeout);
+    void prepareProbe(const std::string& dirUrl, long timeoutMs);
+
+    // Running the prepared command synchronously
+    CURLcode perform();
+
+    // Modification time reported by MDTM for the last RETR, -1 if unknown
+    long fileTime() const;
+
+    // Full size of the remote file reported by SIZE for the last RETR, resumed part included, -1 if unknown
+    curl_off_t expectedSize() const;
+
+private:
+    // Dropping the options of the previous command
+    void reset(long timeout);
+
+    CURL* curl = nullptr;
+    curl_slist* quote = nullptr;
+    curl_off_t resumeFrom = 0;
+    std::string userPwd;
+    long connectTimeout = 0;    // 0 keeps the libcurl default
+};
+
+#endif // FTP_SESSION_H
@@ -0,0 +1,42 @@
+#ifndef ID_ALLOCATOR_H
+#define ID_ALLOCATOR_H
+
+#include <Windows.h>
+#include <sqlext.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Ids of the data table are taken in blocks of this size
+static const int DATA_ID_BLOCK_SIZE = 100;
+
+// Client-side ids of an identity table (hi/lo). A sequence gives the number of a block (hi),
+// the ids inside the block are counted locally (lo), so dependent rows can be built before the insert.
+// The rows are written with IDENTITY_INSERT. While the allocator is in use every row of the table takes
+// its id from it, blocks still start above the current identity value for rows written by older versions
+class IdAllocator {
+public:
+    IdAllocator(const std::wstring& sequence, const std::wstring& table, int blockSize);
+
+    // prohibit copying
+    IdAllocator(const IdAllocator&) = delete;
+    void operator=(const IdAllocator&) = delete;
+
+    // Taking count ascending ids, new blocks are reserved as needed. False if the sequence could not be read
+    bool allocate(SQLHDBC dbc, size_t count, std::vector<int>& ids);
+
+    // Giving up the rest of the block after the allocated ids were rejected
+    void discard();
+
+private:
+    bool reserveBlock(SQLHDBC dbc);
+
+    std::mutex mutex;
+    std::wstring sequence;
+    std::wstring table;
+    int blockSize;
+    long long next = 0;         // Next free id of the block
+    long long end = 0;          // First id after the block
+};
+
+#endif // ID_ALLOCATOR_H
@@ -30,16 +30,65 @@ struct RecordsInfoFromDB {
 	int dataProcess_id = -1;        // ID in data_process table
 };
 
+// Record that was written or completed, the mail about it goes out once its files are in place
+struct RecordNotification {
+    std::wstring substation;
+    FileInfo fileInfo;
+};
+
+// Rows of the data table collected during bulk scans and inserted with one parameter array per flush
+struct DataBatch {
+    struct Entry {
+        FileInfo fileInfo;
+        std::shared_ptr<BaseFile> file;         // File of the common parameters
+        RecordsInfoFromDB recordsInfo;
+        std::wstring key;                       // Identity of the row in the data table
+    };
+
+    // Record of a flushed row and whether the row was written
+    struct Flushed {
+        FileInfo fileInfo;
+        bool written = false;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<Flushed> flushed;               // Taken by the owner of the batch after every call
+    size_t pendingBytes = 0;
+    size_t maxRows = 100;                       // Rows in one INSERT
+    size_t maxBytes = 64 * 1024 * 1024;         // File contents held in memory until the flush
+
+    bool full() const { return entries.size() >= maxRows || pendingBytes >= maxBytes; }
+    bool contains(const std::wstring& key) const;
+
+    // Queued records reported as not written, for an owner without a connection
+    void abandon();
+};
+
+// Outcome of fileIntegrationDB for one record
+enum class RecordWrite {
+    Written,    // The row is in the database: inserted, updated or already there
+    Queued,     // Waiting in the batch, flushDataBatch reports it in DataBatch::flushed
+    Failed      // Nothing written, the record is left for a later scan
+};
+
 class Integration {
 public:
     // Run OMP_C program
     static bool runExternalProgramWithFlag(const std::wstring& programPath, const std::wstring& inputFilePath);
 
-    // Collect paths to files 
-    static void collectRootPaths(std::unordered_set<std::wstring>& parentFolders, const std::wstring rootFolder);
+    // General integration method. With a batch, new data rows are queued and inserted by flushDataBatch
+    static RecordWrite fileIntegrationDB(SQLHDBC dbc, const FileInfo& fileInfo, std::atomic_bool& mailingIsActive, std::atomic_bool& dbIsFull,
+        DataBatch* batch = nullptr);
+
+    // Inserting the queued data rows in one transaction and finishing their records.
+    // Every queued record lands in batch.flushed with the outcome of its row
+    static void flushDataBatch(SQLHDBC dbc, DataBatch& batch, std::atomic_bool& mailingIsActive, std::atomic_bool& dbIsFull);
+
+    // Notifications of the calling thread are collected in the sink instead of being mailed at once, nullptr mails again
+    static void setNotificationSink(std::vector<RecordNotification>* sink);
 
-    // General integration method
-    static void fileIntegrationDB(SQLHDBC dbc, const FileInfo& fileInfo, std::atomic_bool& mailingIsActive, std::atomic_bool& dbIsFull);
+    // Mail about a written record to the users of its substation
+    static void sendRecordMail(SQLHDBC dbc, bool mailingIsActive, const RecordNotification& notification);
 
     // Method for sorting by folders
     static void sortFiles(const FileInfo& fileInfo);
@@ -50,12 +99,6 @@ public:
     // Method to get path for file by recon number
     static std::wstring getPathByRNumber(int recon_id, SQLHDBC dbc);
 
-    //Getting values ​​by markers in a file
-    static std::wstring extractParamValue(const std::wstring& content, const std::wstring& marker);
-
-    // Getting values ​​by regular expressions
-    static std::wstring extractValueWithRegex(const std::wstring& content, const std::wregex& regex);
-
     // Helper function for concatenating strings with a separator
     static std::wstring join(const std::vector<std::wstring>& parts, const std::wstring& delimiter);
 
@@ -63,21 +106,16 @@ public:
     static bool isSortedFolder(const std::wstring& folderName);
 
 private:
-    // Checking file name for validity
-    static bool isFileNameValid(const std::wstring& fileName);
- 
-    // Checking file name starting with 'RECON'
-    static bool checkIsDataFile(const std::wstring& fileName);
-
-    // Checking file name starting with 'REXPR'
-    static bool checkIsExpressFile(const std::wstring& fileName);
-
-    // Checking file for type rnet. prpusk. daily и diagn
-    static bool checkIsOtherFiles(const std::wstring& fileName);
-
     // Getting id's from tables: data, units, struct 
     static void getRecordInfo(SQLHDBC dbc, std::shared_ptr<BaseFile> file, RecordsInfoFromDB &recordsInfo);
 
+    // Getting the data row of a file whose unit and struct ids are already known
+    static void getDataRecordInfo(SQLHDBC dbc, std::shared_ptr<BaseFile> file, RecordsInfoFromDB& recordsInfo);
+
+    // Whole record in one call of integrate_file_record. False if it has to go through the separate statements
+    static bool upsertFileRecord(SQLHDBC dbc, const FileInfo& fileInfo, std::shared_ptr<BaseFile> file,
+        RecordsInfoFromDB& recordsInfo, bool updateLogs, bool& dataChanged);
+
     // Insert into units
     static int insertIntoUnitTable(SQLHDBC dbc, const std::shared_ptr<BaseFile> file);
 
@@ -87,6 +125,20 @@ private:
     // Insert into data
     static int insertIntoDataTable(SQLHDBC dbc, const FileInfo& fileInfo, RecordsInfoFromDB recordsInfo);
 
+    // Array-bound insert of the batch, one statement per column set. Ids in the order of the entries, empty on failure.
+    // With client-side ids the data_process rows are inserted too and their ids set in the entries
+    static std::vector<int> insertIntoDataTableBatch(SQLHDBC dbc, std::vector<DataBatch::Entry>& entries);
+
+    // Records depending on a new data row: logs and data_process
+    static void finishDataRecord(SQLHDBC dbc, const FileInfo& fileInfo, std::shared_ptr<BaseFile> file,
+        RecordsInfoFromDB& recordsInfo, std::atomic_bool& dbIsFull);
+
+    // Mail about a record, or its notification into the sink of the thread
+    static void notifyRecord(SQLHDBC dbc, bool mailingIsActive, const std::wstring& substation, const FileInfo& fileInfo);
+
+    // Identity of the data row of a file, equal for both files of a pair
+    static std::wstring dataRowKey(const BaseFile& file);
+
     // Insert into data_process
     static int insertIntoProcessTable(SQLHDBC dbc, const std::shared_ptr<BaseFile> file, int data_id);
 
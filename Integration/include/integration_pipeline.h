@@ -0,0 +1,72 @@
+#ifndef INTEGRATION_PIPELINE_H
+#define INTEGRATION_PIPELINE_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "integration_workers.h"
+#include "pipeline_stage.h"
+
+// Integration of files in stages connected by bounded queues, so disk, CPU and network work overlap:
+//   read  - collectInfo: file reads, REXPR parsing, OMP_C (readThreads)
+//   persist - database work on the IntegrationWorkers, sharded by recon number
+//   place - moving Cache files to their folder and sorting by date (one thread, keeps the order for notify)
+//   notify - mail about new records, sent from the final location of the files (one thread, own connection)
+// Queue depths are published as pipeline.<stage>.queue_depth gauges. Placed files of written rows are
+// marked in the FileCatalog, drain() commits the marks
+class IntegrationPipeline {
+public:
+    IntegrationPipeline(const IntegrationEngineConfig& config, const std::wstring& rootFolder, const std::wstring& pathToWinRec,
+        std::atomic_bool& mailingIsActive, std::atomic_bool& dbIsFull);
+
+    // prohibit copying
+    IntegrationPipeline(const IntegrationPipeline&) = delete;
+    void operator=(const IntegrationPipeline&) = delete;
+
+    // A file to integrate. Files in Cache name the folder they belong to, batched ones come from a bulk scan
+    void submit(const fs::directory_entry& entry, const std::wstring& targetFolder = L"", bool batched = false);
+
+    // Waiting until every submitted record went through all stages
+    void drain();
+
+private:
+    struct ReadTask {
+        fs::directory_entry entry;
+        std::wstring targetFolder;
+        bool batched = false;
+    };
+
+    struct PlaceTask {
+        FileInfo fileInfo;
+        bool written = false;                   // The row is in the database, the files are marked in the FileCatalog
+        std::vector<RecordNotification> notifications;
+    };
+
+    void read(ReadTask& task);
+    void place(PlaceTask& task);
+    void notify(RecordNotification& notification);
+
+    // A file is in the pipeline from its read until it is placed, the pair partner found later is skipped
+    bool claim(const FileInfo& fileInfo);
+    void release(const std::vector<std::wstring>& paths);
+
+    std::wstring rootFolder;
+    std::wstring pathToWinRec;
+    std::atomic_bool& mailingIsActive;
+
+    std::mutex claimMutex;
+    std::set<std::wstring> claimed;
+
+    Database notifyDb;
+
+    // Declared in reverse order of the data flow, every stage outlives the ones feeding it
+    PipelineStage<RecordNotification> notifyStage;
+    PipelineStage<PlaceTask> placeStage;
+    IntegrationWorkers workers;
+    PipelineStage<ReadTask> readStage;
+};
+
+#endif // INTEGRATION_PIPELINE_H
@@ -0,0 +1,90 @@
+#ifndef INTEGRATION_WORKERS_H
+#define INTEGRATION_WORKERS_H
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "integration_handler.h"
+#include "bounded_queue.h"
+
+// Limits of the parallel integration ("integration_engine" in access_settings)
+struct IntegrationEngineConfig {
+    size_t workers = 4;                 // Threads writing to the database, each with its own connection
+    size_t queueCapacity = 32;          // Records waiting in front of one worker or pipeline stage
+    size_t readThreads = 2;             // Threads reading and parsing files ahead of the workers
+    size_t scanThreads = 4;             // Threads listing directories during the first launch
+    size_t checkpointFiles = 5000;      // Files of the first launch between two commits of the file catalog
+};
+
+// Parsing json string config from database, defaults are kept for missing fields
+IntegrationEngineConfig parseIntegrationEngineConfig(const std::string& jsonString);
+
+// Writes collected records on several threads. A record goes to the worker chosen by its recon number,
+// so every recorder is written by one worker in the order of dispatch and workers never wait for
+// each other's struct, data or logs rows
+class IntegrationWorkers {
+public:
+    // Called on the worker thread once a record was handled, with whether its row was written and the
+    // notifications raised meanwhile. Batched records are reported by the flush of their rows.
+    // An empty record carries notifications only
+    using Persisted = std::function<void(FileInfo&& fileInfo, bool written, std::vector<RecordNotification>&& notifications)>;
+
+    // Without a receiver of persisted records the mail is sent by the workers themselves
+    IntegrationWorkers(const IntegrationEngineConfig& config, std::atomic_bool& mailingIsActive, std::atomic_bool& dbIsFull,
+        Persisted persisted = nullptr);
+
+    // Queued records are written and the batches flushed before the threads stop
+    ~IntegrationWorkers();
+
+    // prohibit copying
+    IntegrationWorkers(const IntegrationWorkers&) = delete;
+    void operator=(const IntegrationWorkers&) = delete;
+
+    // Queueing a collected and sorted record, blocks while its worker is full.
+    // Batched records of a bulk scan are inserted in groups, see DataBatch
+    void dispatch(FileInfo fileInfo, bool batched = false);
+
+    // Waiting until everything dispatched so far is in the database
+    void drain();
+
+private:
+    struct Task {
+        FileInfo fileInfo;
+        bool batched = false;
+        std::shared_ptr<std::promise<void>> drained;    // Marker of drain, no record
+    };
+
+    struct Worker {
+        explicit Worker(size_t capacity) : queue(capacity) {}
+
+        Database db;
+        BoundedQueue<Task> queue;
+        DataBatch batch;
+        std::thread thread;
+    };
+
+    void work(Worker& worker);
+
+    // Handing a record and the notifications of the worker to the receiver
+    void forward(FileInfo& fileInfo, bool written, std::vector<RecordNotification>& notifications);
+
+    // Handing on the records of the rows flushed from the batch of the worker
+    void forwardFlushed(DataBatch& batch, std::vector<RecordNotification>& notifications);
+
+    // Records waiting in all worker queues, published as pipeline.persist.queue_depth
+    void publishDepth() const;
+
+    // Worker of the recorder of a record
+    size_t shardOf(const FileInfo& fileInfo) const;
+
+    std::atomic_bool& mailingIsActive;
+    std::atomic_bool& dbIsFull;
+    Persisted persisted;
+    std::vector<std::unique_ptr<Worker>> workers;
+};
+
+#endif // INTEGRATION_WORKERS_H
@@ -0,0 +1,49 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Process-wide counters and gauges, written to METRICS_LOG_PATH on dump()
+class Metrics {
+public:
+    static Metrics& getInstance() {
+        static Metrics instance;
+        return instance;
+    }
+
+    // prohibit copying
+    Metrics(const Metrics&) = delete;
+    void operator=(const Metrics&) = delete;
+
+    // Adding to a monotonically growing counter
+    void add(const std::string& name, uint64_t value = 1);
+
+    // Setting the current value of a gauge, its high-water mark is kept alongside
+    void setGauge(const std::string& name, int64_t value);
+
+    // Sampling the working set of the process, its high-water mark is the peak memory use
+    void sampleProcessMemory();
+
+    // Current value of a counter, 0 if it was never touched
+    uint64_t counter(const std::string& name) const;
+
+    // Writing all counters and gauges into the metrics log
+    void dump();
+
+private:
+    Metrics() {}
+
+    struct Gauge {
+        int64_t value = 0;
+        int64_t highWater = 0;
+    };
+
+    mutable std::mutex mutex;
+    std::map<std::string, uint64_t> counters;
+    std::map<std::string, Gauge> gauges;
+};
+
+#endif // METRICS_H
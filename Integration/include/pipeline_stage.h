@@ -0,0 +1,88 @@
+#ifndef PIPELINE_STAGE_H
+#define PIPELINE_STAGE_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bounded_queue.h"
+#include "metrics.h"
+
+// Bounded queue served by its own threads. push blocks while the queue is full, which holds back
+// the stage before it. The depth of the queue is published as the gauge "<name>.queue_depth"
+template <typename T>
+class PipelineStage {
+public:
+    using Handler = std::function<void(T&)>;
+
+    PipelineStage(const std::string& name, size_t threadCount, size_t capacity, Handler handler)
+        : gauge(name + ".queue_depth"), queue(capacity), handler(std::move(handler))
+    {
+        for (size_t i = 0; i < (threadCount ? threadCount : 1); ++i) {
+            threads.emplace_back([this]() { run(); });
+        }
+    }
+
+    // Items already queued are handled before the threads stop
+    ~PipelineStage() {
+        queue.close();
+        for (auto& thread : threads) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+    }
+
+    // prohibit copying
+    PipelineStage(const PipelineStage&) = delete;
+    void operator=(const PipelineStage&) = delete;
+
+    void push(T item) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++pending;
+        }
+        if (!queue.push(std::move(item))) {
+            finished();
+            return;
+        }
+        Metrics::getInstance().setGauge(gauge, static_cast<int64_t>(queue.size()));
+    }
+
+    // Waiting until every item pushed so far was handled
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    void run() {
+        T item;
+        while (queue.pop(item)) {
+            Metrics::getInstance().setGauge(gauge, static_cast<int64_t>(queue.size()));
+            handler(item);
+            item = T();
+            finished();
+        }
+    }
+
+    void finished() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0) {
+            idle.notify_all();
+        }
+    }
+
+    std::string gauge;
+    BoundedQueue<T> queue;
+    Handler handler;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable idle;
+    size_t pending = 0;
+};
+
+#endif // PIPELINE_STAGE_H
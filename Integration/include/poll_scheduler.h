@@ -0,0 +1,47 @@
+#ifndef POLL_SCHEDULER_H
+#define POLL_SCHEDULER_H
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Per-directory polling schedule driven by the observed file arrival rate.
+// Busy directories are listed again soon, quiet ones back off towards the upper bound.
+class PollScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Bounds of the interval between two listings of one directory
+    void configure(std::chrono::seconds minInterval, std::chrono::seconds maxInterval);
+
+    // Whether the directory should be listed now, unknown directories are always due
+    bool isDue(const std::string& key) const;
+
+    // Result of one listing: files taken and whether the per-session cap cut the listing short
+    void recordPoll(const std::string& key, size_t filesFound, bool backlog);
+
+    // Time until the first directory becomes due, within the interval bounds
+    std::chrono::seconds timeUntilNextPoll() const;
+
+private:
+    struct Entry {
+        Clock::time_point lastPoll;
+        Clock::time_point nextPoll;
+        std::chrono::seconds interval{ 0 };
+        double arrivalRate = 0.0;       // Files per second, exponentially smoothed
+    };
+
+    // Expected number of files waiting at the next listing of a busy directory
+    static constexpr double targetFilesPerPoll = 10.0;
+
+    // Weight of the latest sample in the smoothed rate
+    static constexpr double rateSmoothing = 0.3;
+
+    mutable std::mutex mutex;
+    std::map<std::string, Entry> entries;
+    std::chrono::seconds minInterval{ 10 };
+    std::chrono::seconds maxInterval{ 600 };
+};
+
+#endif // POLL_SCHEDULER_H
@@ -0,0 +1,62 @@
+#ifndef REFERENCE_CACHE_H
+#define REFERENCE_CACHE_H
+
+#include <Windows.h>
+#include <sqlext.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+
+class StatementCache;
+
+// In-memory copy of the rarely changing reference tables: units, struct, struct_units and the
+// FTP_Directories paths. Loaded in bulk, kept up to date by the inserts of this process.
+// A miss is not proof of absence, callers ask the database and store what they find.
+class ReferenceCache {
+public:
+    static ReferenceCache& getInstance() {
+        static ReferenceCache instance;
+        return instance;
+    }
+
+    // prohibit copying
+    ReferenceCache(const ReferenceCache&) = delete;
+    void operator=(const ReferenceCache&) = delete;
+
+    // Replacing the content with the current tables, false if a query failed
+    bool load(SQLHDBC dbc);
+
+    // Reading FTP_Directories again, the operators may move the folder of a recorder at any time
+    bool reloadLocalPaths(SQLHDBC dbc);
+
+    // Forgetting everything, for example after the tables were emptied
+    void clear();
+
+    // Ids, -1 if not cached
+    int unitId(const std::wstring& unit, const std::wstring& substation) const;
+    int structId(int reconId, const std::wstring& object) const;
+    bool hasStructUnit(int unitId, int structId) const;
+
+    // Local folder of a recorder, empty if not cached
+    std::wstring localPath(int reconId) const;
+
+    void addUnit(const std::wstring& unit, const std::wstring& substation, int id);
+    void addStruct(int reconId, const std::wstring& object, int id);
+    void addStructUnit(int unitId, int structId);
+    void addLocalPath(int reconId, const std::wstring& path);
+
+private:
+    ReferenceCache() = default;
+
+    static bool queryLocalPaths(StatementCache& statements, std::map<int, std::wstring>& loadedPaths);
+
+    mutable std::mutex mutex;
+    std::map<std::pair<std::wstring, std::wstring>, int> units;
+    std::map<std::pair<int, std::wstring>, int> structs;
+    std::set<std::pair<int, int>> structUnits;
+    std::map<int, std::wstring> localPaths;
+};
+
+#endif // REFERENCE_CACHE_H
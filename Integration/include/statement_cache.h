@@ -0,0 +1,119 @@
+#ifndef STATEMENT_CACHE_H
+#define STATEMENT_CACHE_H
+
+#include <Windows.h>
+#include <sqlext.h>
+#include <sqltypes.h>
+#include <sql.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Binary parameter, bound without copying the data
+struct SqlBinary {
+    const void* data = nullptr;
+    SQLLEN size = 0;
+};
+
+// Binary parameter sent in parts once execute returns SQL_NEED_DATA, SQLParamData hands the token back
+struct SqlStream {
+    const void* token = nullptr;        // NULL is bound without a token
+    SQLLEN size = 0;
+};
+
+// Statement prepared once on its connection and executed many times
+class CachedStatement {
+public:
+    explicit CachedStatement(SQLHSTMT hstmt) : hstmt(hstmt) {}
+    ~CachedStatement();
+
+    // prohibit copying
+    CachedStatement(const CachedStatement&) = delete;
+    void operator=(const CachedStatement&) = delete;
+
+    SQLHSTMT handle() const { return hstmt; }
+
+    // Binding the arguments to the markers in order and executing, the previous cursor is closed first.
+    // The arguments are bound by address. Without an SqlStream argument they are read during the call,
+    // with one the caller answers SQL_NEED_DATA and the driver reads them only then: every argument
+    // must stay alive until SQLParamData is done, temporaries are not allowed
+    template <typename... Args>
+    SQLRETURN execute(const Args&... args) {
+        reset(sizeof...(Args));
+        SQLUSMALLINT index = 1;
+        bool bound = (true && ... && bind(index++, args));
+        if (!bound) {
+            return SQL_ERROR;
+        }
+        return SQLExecute(hstmt);
+    }
+
+    // Moving to the next row of the result
+    bool fetch();
+
+    // Reading a column of the current row, false if it is NULL
+    bool get(SQLUSMALLINT column, int& value);
+    bool get(SQLUSMALLINT column, std::wstring& value);
+
+    // Closing the cursor, without MARS the connection is busy until then
+    void close();
+
+private:
+    void reset(size_t parameterCount);
+
+    // Typed binders, the SQL types and sizes stay the same between executions so the plan is reused
+    bool bind(SQLUSMALLINT index, const int& value);
+    bool bind(SQLUSMALLINT index, const std::wstring& value);
+    bool bind(SQLUSMALLINT index, const SqlBinary& value);
+    bool bind(SQLUSMALLINT index, const SqlStream& value);
+
+    SQLHSTMT hstmt = SQL_NULL_HSTMT;
+    std::vector<SQLLEN> indicators;
+};
+
+// Statement taken from the cache, its cursor is closed when the lease ends
+class StatementLease {
+public:
+    explicit StatementLease(CachedStatement* statement) : statement(statement) {}
+    ~StatementLease() {
+        if (statement) {
+            statement->close();
+        }
+    }
+
+    StatementLease(StatementLease&& other) noexcept : statement(other.statement) { other.statement = nullptr; }
+    StatementLease(const StatementLease&) = delete;
+    void operator=(const StatementLease&) = delete;
+
+    CachedStatement* operator->() const { return statement; }
+    explicit operator bool() const { return statement != nullptr; }
+
+private:
+    CachedStatement* statement = nullptr;
+};
+
+// Prepared statements of one connection, keyed by the query text
+class StatementCache {
+public:
+    // Cache of the connection, created on first use
+    static StatementCache& forConnection(SQLHDBC dbc);
+
+    // Freeing the statements of the connection, called before it is closed or reconnected
+    static void release(SQLHDBC dbc);
+
+    // Statement of the query, prepared the first time it is asked for. Empty lease if the preparation failed
+    StatementLease acquire(const std::wstring& sql);
+
+private:
+    explicit StatementCache(SQLHDBC dbc) : dbc(dbc) {}
+
+    SQLHDBC dbc = SQL_NULL_HDBC;
+    std::map<std::wstring, std::unique_ptr<CachedStatement>> statements;
+
+    static std::mutex registryMutex;
+    static std::map<SQLHDBC, std::unique_ptr<StatementCache>> registry;
+};
+
+#endif // STATEMENT_CACHE_H
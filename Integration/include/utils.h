@@ -29,7 +29,6 @@
 #include <iomanip>
 #include <unordered_set>
 #include <mutex>
-#include <iconv.h>
 #include <regex>
 #include <cwctype>
 #include <openssl/evp.h>
@@ -48,6 +47,7 @@ const std::string INTEGRATION_LOG_PATH = "ErrorsIntegration.txt";
 const std::string EMAIL_LOG_PATH = "ErrorsEmail.txt";
 const std::string ONEDRIVE_LOG_PATH = "ErrorsOneDrive.txt";
 const std::string EXCEPTION_LOG_PATH = "Exceptions.txt";
+const std::string METRICS_LOG_PATH = "Metrics.txt";
 
 // TODO: meybe should some with this log functions doing
 void trimLogFile(const std::string& filePath);
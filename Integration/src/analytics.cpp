@@ -3,11 +3,24 @@
 std::vector<std::wstring> Analytics::GetUnreachableServers(std::vector<ServerInfo> servers, SQLHDBC dbc)
 {
 	std::vector<std::wstring> unreachableServers;
+	CircuitBreaker& breaker = Ftp::getInstance().circuitBreaker();
 	for (const auto& server : servers) {
+		std::string host = wstringToString(server.ip);
+
+		// A recorder in backoff is reported without spending a connect timeout on it
+		if (!breaker.allowRequest(host)) {
+			unreachableServers.push_back(server.unit + L" - " + server.substation + L" (" + server.ip + L")");
+			continue;
+		}
+
 		std::wstring url = Ftp::getInstance().protocol() + server.ip;
 		if (!Ftp::getInstance().checkConnection(wstringToString(url), wstringToString(server.login), wstringToString(server.pass))) {
+			breaker.recordFailure(host);
 			unreachableServers.push_back(server.unit + L" - " + server.substation + L" (" + server.ip + L")");
 		}
+		else {
+			breaker.recordSuccess(host);
+		}
 	}
 	return unreachableServers;
 }
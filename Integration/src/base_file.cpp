@@ -1,40 +1,54 @@
 #include "base_file.h"
+#include "express_header.h"
+#include "file_view.h"
+#include "file_name.h"
 
 
 std::string BaseFile::readFileContent() {
     if (fullPath.empty()) {
         return "";
     }
-    std::ifstream file(fullPath, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {  
+
+    // Copied once from the mapped pages, without a zero-filled buffer and a stream in between
+    FileView view(fullPath);
+    if (!view.valid()) {
         return "";
     }
-    if (file.fail()) {
-        return "";
+    binaryDataSize = view.size();
+    return std::string(view.data(), view.size());
+}
+
+
+bool BaseFile::statFileContent() {
+    contentOnDisk = false;
+    if (fullPath.empty()) {
+        return false;
     }
-    try {
-        std::uintmax_t size = fs::file_size(fullPath);
-        if (size <= 0 || size == std::streamsize(-1)) {
-            //logError(L"Incorrect size in readFileContent" + fullPath, LOG_PATH);
-            return "";
-        }
 
-        binaryDataSize = size;
-        file.seekg(0, std::ios::beg);       
+    boost::system::error_code ec;
+    std::uintmax_t size = fs::file_size(fullPath, ec);
+    if (ec || size == 0) {
+        return false;
+    }
 
-        std::string buffer(size, '\0');
-        if (!file.read(&buffer[0], size)) {
-            return "";
-        }
+    binaryDataSize = static_cast<size_t>(size);
+    contentOnDisk = true;
+    return true;
+}
 
-        return buffer;
+bool BaseFile::loadContent() {
+    if (!binaryData.empty() || !contentOnDisk) {
+        return !binaryData.empty();
     }
-    catch (...) {
-        return "";
+
+    binaryData = readFileContent();
+    if (binaryData.empty()) {
+        return false;
     }
+    contentOnDisk = false;
+    return true;
 }
 
-
 void BaseFile::processPath(std::wstring rootFolder)
 {
     // We get the path to the parent folder
@@ -73,15 +87,13 @@ void BaseFile::processPath(std::wstring rootFolder)
         // The rest combine into unit
         unit = Integration::join(pathParts, L" - ");
     }
-    int reconNum;
-    if (fileName.size() >= 8) {
-        reconNum = std::stoi(fileName.substr(5, 3));
+    int reconNum = parseFileName(fileName).reconNumber;
+    if (reconNum >= 0) {
+        reconNumber = reconNum;
     }
     else {
-        logError(L"[BaseFile::processPath] fileName.size() <= 8. File name: " + fileName, INTEGRATION_LOG_PATH);
+        logError(L"[BaseFile::processPath] No recon number in file name: " + fileName, INTEGRATION_LOG_PATH);
     }
-
-    reconNumber = reconNum;
 }
 
 bool BaseFile::getFileDateAndTime()
@@ -117,54 +129,51 @@ bool BaseFile::getFileDateAndTime()
     return true;
 }
 
-void ExpressFile::readDataFromFile() {
+bool ExpressFile::readMetadata() {
     try {
-        std::string fileContent = readFileContent();
-
-        std::string utf8Content = cp866_to_utf8(fileContent);
-        std::wstring wideFileContent = stringToWString(utf8Content);
-        binaryData = fileContent;
+        contentOnDisk = false;
 
+        // The fields sit in the leading text, the parser stops there and only those pages are read
+        FileView view(fullPath);
+        if (!view.valid()) {
+            return false;
+        }
+        ExpressHeader header = parseExpressHeader(view.data(), view.size());
 
-        std::map<std::wstring, std::wregex> regexMap = {
-            {L"date", std::wregex(L"\\s*:?\\s*(\\d{2}/\\d{2}/\\d{4})")},
-            {L"time", std::wregex(L"(?:\\s+)?\\s*:?\\s*(\\d{2}:\\d{2}:\\d{2}\\.\\d{3})")},
-            {L"reconObject", std::wregex(L":\\s*(.*)")},
-            {L"factor", std::wregex(L" :\\s*(.*)")},
-            {L"typeKz", std::wregex(L".*:\\s*(.*)")},
-            {L"damagedLine", std::wregex(L" , :\\s*(.*)")}
-        };
+        // The content is streamed or loaded only when its BLOB is written
+        binaryDataSize = view.size();
+        contentOnDisk = true;
 
-        date = Integration::extractValueWithRegex(wideFileContent, regexMap[L"date"]);
-        time = Integration::extractValueWithRegex(wideFileContent, regexMap[L"time"]);
-        factor = Integration::extractValueWithRegex(wideFileContent, regexMap[L"factor"]);
-        typeKz = Integration::extractValueWithRegex(wideFileContent, regexMap[L"typeKz"]);
-        damagedLine = Integration::extractValueWithRegex(wideFileContent, regexMap[L"damagedLine"]);
+        date = header.date;
+        time = header.time;
+        factor = header.factor;
+        typeKz = header.typeKz;
+        damagedLine = header.damagedLine;
 
         if (date.empty() || time.empty() || factor.empty() || typeKz.empty()) {
             if (date.empty()) {
-                date = Integration::extractParamValue(wideFileContent, L"$DP=");
+                date = header.paramDate;
             }
             if (time.empty()) {
-                time = Integration::extractParamValue(wideFileContent, L"$TP=");
+                time = header.paramTime;
             }
             if (factor.empty()) {
-                factor = Integration::extractParamValue(wideFileContent, L"$SF=");
+                factor = header.paramFactor;
             }
             if (typeKz.empty()) {
-                typeKz = Integration::extractParamValue(wideFileContent, L"$LF=");
+                typeKz = header.paramLineFault;
                 if (typeKz == L"1" || typeKz == L"2" || typeKz == L"3" || typeKz == L"4") {
-                    std::string templateStr = "  ";
-                    typeKz += stringToWString(templateStr);
+                    typeKz += L"  ";
                 }
                 else {
                     typeKz = L" ";
                 }
             }
         }
-
+        return true;
     }
     catch (const std::exception& e) {
-        logError(stringToWString("Exception caught in readDataFromFile: ") + fileName + L" " + stringToWString(e.what()), INTEGRATION_LOG_PATH);
+        logError(stringToWString("Exception caught in readMetadata: ") + fileName + L" " + stringToWString(e.what()), INTEGRATION_LOG_PATH);
     }
+    return false;
 }
\ No newline at end of file
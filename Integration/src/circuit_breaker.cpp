@@ -0,0 +1,118 @@
+#include "circuit_breaker.h"
+#include "metrics.h"
+#include "utils.h"
+
+void CircuitBreaker::configure(int failureThreshold, std::chrono::seconds baseBackoff, std::chrono::seconds maxBackoff)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->failureThreshold = failureThreshold > 0 ? failureThreshold : 1;
+    this->baseBackoff = baseBackoff;
+    this->maxBackoff = maxBackoff > baseBackoff ? maxBackoff : baseBackoff;
+}
+
+std::chrono::milliseconds CircuitBreaker::nextBackoff(int openCount)
+{
+    using namespace std::chrono;
+
+    milliseconds backoff = duration_cast<milliseconds>(baseBackoff);
+    for (int i = 1; i < openCount && backoff < maxBackoff; ++i) {
+        backoff *= 2;
+    }
+    if (backoff > maxBackoff) {
+        backoff = duration_cast<milliseconds>(maxBackoff);
+    }
+
+    // Recorders that failed together do not come back in one burst
+    std::uniform_int_distribution<long long> jitter(0, backoff.count() / 2);
+    return milliseconds(backoff.count() / 2 + jitter(random));
+}
+
+bool CircuitBreaker::allowRequest(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return true;
+    }
+
+    Entry& entry = it->second;
+    switch (entry.state) {
+    case BreakerState::Closed:
+        return true;
+    case BreakerState::Open:
+        if (Clock::now() < entry.retryAt) {
+            Metrics::getInstance().add("ftp.breaker_skipped");
+            return false;
+        }
+        entry.state = BreakerState::HalfOpen;
+        // A trial whose result never arrives does not block the recorder forever
+        entry.retryAt = Clock::now() + baseBackoff;
+        return true;
+    case BreakerState::HalfOpen:
+        if (Clock::now() >= entry.retryAt) {
+            entry.retryAt = Clock::now() + baseBackoff;
+            return true;
+        }
+        // The trial request is already running
+        Metrics::getInstance().add("ftp.breaker_skipped");
+        return false;
+    }
+    return true;
+}
+
+void CircuitBreaker::recordSuccess(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return;
+    }
+
+    if (it->second.state != BreakerState::Closed) {
+        logError(L"[FTP] Server is reachable again, breaker closed: " + stringToWString(key), FTP_LOG_PATH);
+    }
+    entries.erase(it);
+}
+
+void CircuitBreaker::recordFailure(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = entries[key];
+    ++entry.consecutiveFailures;
+
+    if (entry.state == BreakerState::HalfOpen || entry.consecutiveFailures >= failureThreshold) {
+        ++entry.openCount;
+        auto backoff = nextBackoff(entry.openCount);
+        entry.state = BreakerState::Open;
+        entry.retryAt = Clock::now() + backoff;
+        logError(L"[FTP] Server is unreachable, breaker opened for " +
+            std::to_wstring(std::chrono::duration_cast<std::chrono::seconds>(backoff).count()) + L" s: " +
+            stringToWString(key), FTP_LOG_PATH);
+    }
+}
+
+BreakerState CircuitBreaker::state(const std::string& key) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    return it != entries.end() ? it->second.state : BreakerState::Closed;
+}
+
+void CircuitBreaker::exportMetrics() const
+{
+    int64_t open = 0, halfOpen = 0, failing = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& entry : entries) {
+            switch (entry.second.state) {
+            case BreakerState::Open: ++open; break;
+            case BreakerState::HalfOpen: ++halfOpen; break;
+            case BreakerState::Closed: ++failing; break;
+            }
+        }
+    }
+
+    Metrics::getInstance().setGauge("ftp.breaker_open", open);
+    Metrics::getInstance().setGauge("ftp.breaker_half_open", halfOpen);
+    Metrics::getInstance().setGauge("ftp.breaker_closed_failing", failing);
+}
@@ -0,0 +1,156 @@
+#include "cp866_decoder.h"
+#include <cstring>
+#include <cwchar>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CP866_DECODER_SSE2
+#endif
+
+namespace {
+
+// Bytes 0x80-0xFF: Cyrillic letters, box drawing, Ukrainian and Belarusian letters, signs
+const wchar_t HIGH_HALF[128] = {
+    0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,
+    0x0418, 0x0419, 0x041A, 0x041B, 0x041C, 0x041D, 0x041E, 0x041F,
+    0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,
+    0x0428, 0x0429, 0x042A, 0x042B, 0x042C, 0x042D, 0x042E, 0x042F,
+    0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+    0x0438, 0x0439, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E, 0x043F,
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+    0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+    0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+    0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+    0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+    0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+    0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+    0x0448, 0x0449, 0x044A, 0x044B, 0x044C, 0x044D, 0x044E, 0x044F,
+    0x0401, 0x0451, 0x0404, 0x0454, 0x0407, 0x0457, 0x040E, 0x045E,
+    0x00B0, 0x2219, 0x00B7, 0x221A, 0x2116, 0x00A4, 0x25A0, 0x00A0,
+};
+
+// The whole code page looked up by byte, mixed text is decoded without a branch per byte
+struct CodePage {
+    wchar_t chars[256];
+    char utf8[256][4];              // UTF-8 sequence padded to 4 bytes, stored whole
+    unsigned char utf8Length[256];
+
+    CodePage() {
+        for (unsigned int code = 0; code < 256; ++code) {
+            unsigned int ch = code < 0x80 ? code : static_cast<unsigned int>(HIGH_HALF[code - 0x80]);
+            chars[code] = static_cast<wchar_t>(ch);
+            char* out = utf8[code];
+            out[1] = out[2] = out[3] = 0;
+            if (ch < 0x80) {
+                out[0] = static_cast<char>(ch);
+                utf8Length[code] = 1;
+            }
+            else if (ch < 0x800) {
+                out[0] = static_cast<char>(0xC0 | (ch >> 6));
+                out[1] = static_cast<char>(0x80 | (ch & 0x3F));
+                utf8Length[code] = 2;
+            }
+            else {
+                out[0] = static_cast<char>(0xE0 | (ch >> 12));
+                out[1] = static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+                out[2] = static_cast<char>(0x80 | (ch & 0x3F));
+                utf8Length[code] = 3;
+            }
+        }
+    }
+};
+
+const CodePage CODE_PAGE;
+
+inline wchar_t decodeByte(char byte) {
+    return CODE_PAGE.chars[static_cast<unsigned char>(byte)];
+}
+
+// One to three bytes in UTF-8, the output has room for a fourth
+inline size_t appendUtf8(char byte, char* out) {
+    unsigned char code = static_cast<unsigned char>(byte);
+    std::memcpy(out, CODE_PAGE.utf8[code], 4);
+    return CODE_PAGE.utf8Length[code];
+}
+
+} // namespace
+
+Cp866Decoder& Cp866Decoder::forThisThread()
+{
+    thread_local Cp866Decoder decoder;
+    return decoder;
+}
+
+const std::wstring& Cp866Decoder::toWide(const char* data, size_t size)
+{
+    wide.resize(size);
+    if (size == 0) {
+        return wide;
+    }
+    wchar_t* out = &wide[0];
+    size_t i = 0;
+
+#ifdef CP866_DECODER_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        if (_mm_movemask_epi8(chunk) != 0) {
+            for (size_t k = i; k < i + 16; ++k) {
+                out[k] = decodeByte(data[k]);
+            }
+            continue;
+        }
+
+        // Pure ASCII, every byte is zero-extended to a character
+        __m128i low = _mm_unpacklo_epi8(chunk, zero);
+        __m128i high = _mm_unpackhi_epi8(chunk, zero);
+#if WCHAR_MAX > 0xFFFF
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi16(low, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_unpackhi_epi16(low, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpacklo_epi16(high, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 12), _mm_unpackhi_epi16(high, zero));
+#else
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), low);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), high);
+#endif
+    }
+#endif
+
+    for (; i < size; ++i) {
+        out[i] = decodeByte(data[i]);
+    }
+    return wide;
+}
+
+const std::string& Cp866Decoder::toUtf8(const char* data, size_t size)
+{
+    if (size == 0) {
+        utf8.clear();
+        return utf8;
+    }
+    // Every sequence is stored as 4 bytes, the last one may reach one byte past 3 per character
+    utf8.resize(size * 3 + 1);
+    char* out = &utf8[0];
+    size_t length = 0;
+    size_t i = 0;
+
+#ifdef CP866_DECODER_SSE2
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        if (_mm_movemask_epi8(chunk) == 0) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + length), chunk);
+            length += 16;
+            continue;
+        }
+        for (size_t k = i; k < i + 16; ++k) {
+            length += appendUtf8(data[k], out + length);
+        }
+    }
+#endif
+
+    for (; i < size; ++i) {
+        length += appendUtf8(data[i], out + length);
+    }
+    utf8.resize(length);
+    return utf8;
+}
@@ -1,4 +1,6 @@
 #include "db_connection.h"
+#include "statement_cache.h"
+#include "id_allocator.h"
 #include "utils.h"
 
 #ifdef UNICODE
@@ -14,6 +16,140 @@
 namespace fs = boost::filesystem;
 
 std::wstring Database::configFileName = L"";
+std::atomic_bool Database::upsertProcedureReady{ false };
+
+// Whole integration of one record in a single call: units, struct, struct_units, data, data_process and logs.
+// Returns the ids and whether the data row was inserted or completed, the caller sends the mail then
+static const wchar_t* const INTEGRATE_FILE_RECORD_PROCEDURE = LR"(
+CREATE OR ALTER PROCEDURE [integrate_file_record]
+    @unit NVARCHAR(255),
+    @substation NVARCHAR(255),
+    @recon_id INT,
+    @object NVARCHAR(255),
+    @files_path NVARCHAR(MAX),
+    @file_num NVARCHAR(255),
+    @date DATE,
+    @time TIME(3),
+    @file_type NVARCHAR(255),
+    @data_file VARBINARY(MAX),
+    @express_file VARBINARY(MAX),
+    @other_type_file VARBINARY(MAX),
+    @need_process BIT,
+    @damaged_line NVARCHAR(255),
+    @trigger NVARCHAR(255),
+    @event_type NVARCHAR(255),
+    @update_logs BIT,
+    @last_ping NVARCHAR(32),
+    @last_recon NVARCHAR(32),
+    @last_daily NVARCHAR(32),
+    @new_data_id INT = -1
+AS
+BEGIN
+    SET NOCOUNT ON;
+    SET XACT_ABORT ON;
+
+    DECLARE @unit_id INT, @struct_id INT, @data_id INT, @dataProcess_id INT, @data_changed BIT = 0;
+
+    BEGIN TRANSACTION;
+
+    SELECT @unit_id = id FROM [units] WITH (UPDLOCK, HOLDLOCK)
+    WHERE [unit] = @unit AND [substation] = @substation;
+    IF @unit_id IS NULL
+    BEGIN
+        INSERT INTO [units] ([unit], [substation]) VALUES (@unit, @substation);
+        SET @unit_id = SCOPE_IDENTITY();
+    END
+
+    SELECT @struct_id = id FROM [struct] WITH (UPDLOCK, HOLDLOCK)
+    WHERE [recon_id] = @recon_id AND [object] = @object;
+    IF @struct_id IS NULL
+    BEGIN
+        INSERT INTO [struct] ([recon_id], [object], [files_path]) VALUES (@recon_id, @object, @files_path);
+        SET @struct_id = SCOPE_IDENTITY();
+    END
+
+    IF NOT EXISTS (SELECT 1 FROM [struct_units] WITH (UPDLOCK, HOLDLOCK) WHERE [unit_id] = @unit_id AND [struct_id] = @struct_id)
+        INSERT INTO [struct_units] ([unit_id], [struct_id]) VALUES (@unit_id, @struct_id);
+
+    -- RECON and REXPR of one record share a row, other types are told apart by type and time
+    IF @file_type IN (N'RECON', N'REXPR')
+        SELECT TOP 1 @data_id = id FROM [data] WITH (UPDLOCK, HOLDLOCK)
+        WHERE [struct_id] = @struct_id AND [file_num] = @file_num AND [date] = @date
+        ORDER BY id DESC;
+    ELSE
+        SELECT TOP 1 @data_id = id FROM [data] WITH (UPDLOCK, HOLDLOCK)
+        WHERE [struct_id] = @struct_id AND [file_num] = @file_num AND [time] = @time AND [file_type] = @file_type
+        ORDER BY id DESC;
+
+    IF @data_id IS NULL
+    BEGIN
+        IF @data_file IS NOT NULL OR @express_file IS NOT NULL OR @other_type_file IS NOT NULL
+        BEGIN
+            -- An id from the client allocator, the identity numbers the rows only while it is not in use
+            IF @new_data_id = -1
+            BEGIN
+                INSERT INTO [data] ([struct_id], [date], [time], [file_num], [data_file], [express_file], [other_type_file], [file_type])
+                VALUES (@struct_id, @date, @time, @file_num, @data_file, @express_file, @other_type_file,
+                    CASE WHEN @other_type_file IS NULL THEN NULL ELSE @file_type END);
+                SET @data_id = SCOPE_IDENTITY();
+            END
+            ELSE
+            BEGIN
+                SET IDENTITY_INSERT [data] ON;
+                INSERT INTO [data] ([id], [struct_id], [date], [time], [file_num], [data_file], [express_file], [other_type_file], [file_type])
+                VALUES (@new_data_id, @struct_id, @date, @time, @file_num, @data_file, @express_file, @other_type_file,
+                    CASE WHEN @other_type_file IS NULL THEN NULL ELSE @file_type END);
+                SET IDENTITY_INSERT [data] OFF;
+                SET @data_id = @new_data_id;
+            END
+            SET @data_changed = 1;
+        END
+    END
+    ELSE IF @other_type_file IS NULL
+    BEGIN
+        -- The second file of a pair fills its empty column, a stored file is never replaced
+        UPDATE [data] SET
+            [time] = CASE WHEN ISNULL(DATALENGTH([express_file]), 0) = 0 AND @express_file IS NOT NULL THEN @time ELSE [time] END,
+            [express_file] = CASE WHEN ISNULL(DATALENGTH([express_file]), 0) = 0 AND @express_file IS NOT NULL THEN @express_file ELSE [express_file] END,
+            [data_file] = CASE WHEN ISNULL(DATALENGTH([data_file]), 0) = 0 AND @data_file IS NOT NULL THEN @data_file ELSE [data_file] END
+        WHERE id = @data_id
+            AND ((ISNULL(DATALENGTH([express_file]), 0) = 0 AND @express_file IS NOT NULL)
+              OR (ISNULL(DATALENGTH([data_file]), 0) = 0 AND @data_file IS NOT NULL));
+        IF @@ROWCOUNT > 0
+            SET @data_changed = 1;
+    END
+
+    IF @need_process = 1 AND @data_id IS NOT NULL
+    BEGIN
+        SELECT @dataProcess_id = id FROM [data_process] WITH (UPDLOCK, HOLDLOCK) WHERE id = @data_id;
+        IF @dataProcess_id IS NULL
+        BEGIN
+            INSERT INTO [data_process] ([id], [damaged_line], [trigger], [event_type])
+            VALUES (@data_id, @damaged_line, @trigger, @event_type);
+            SET @dataProcess_id = @data_id;
+        END
+    END
+
+    -- Dates come as yyyy-mm-dd hh:mi:ss, an empty one leaves the column as it is
+    IF @update_logs = 1 AND @data_id IS NOT NULL
+    BEGIN
+        IF EXISTS (SELECT 1 FROM [logs] WITH (UPDLOCK, HOLDLOCK) WHERE [recon_id] = @struct_id)
+            UPDATE [logs] SET
+                [last_ping] = ISNULL(CONVERT(DATETIME, NULLIF(@last_ping, N''), 120), [last_ping]),
+                [last_recon] = ISNULL(CONVERT(DATETIME, NULLIF(@last_recon, N''), 120), [last_recon]),
+                [last_daily] = ISNULL(CONVERT(DATETIME, NULLIF(@last_daily, N''), 120), [last_daily])
+            WHERE [recon_id] = @struct_id;
+        ELSE
+            INSERT INTO [logs] ([last_ping], [last_recon], [last_daily], [recon_id])
+            VALUES (CONVERT(DATETIME, NULLIF(@last_ping, N''), 120), CONVERT(DATETIME, NULLIF(@last_recon, N''), 120),
+                CONVERT(DATETIME, NULLIF(@last_daily, N''), 120), @struct_id);
+    END
+
+    COMMIT TRANSACTION;
+
+    SELECT @unit_id, @struct_id, @data_id, @dataProcess_id, @data_changed;
+END
+)";
 
 Database::Database(){}
 
@@ -216,6 +352,7 @@ bool Database::connectToDatabase() {
             }
         }
         else {
+            StatementCache::release(dbc);
             SQLDisconnect(dbc);
         }
 
@@ -350,10 +487,33 @@ int Database::executeSQLAndGetIntResult(SQLHDBC dbc, const std::wstringstream& q
     return result;
 }
 
+// Migration steps in the order they were introduced
+bool Database::applyMigrations(SQLHDBC dbc) {
+    std::wstringstream upsertProcedure;
+    upsertProcedure << INTEGRATE_FILE_RECORD_PROCEDURE;
+    upsertProcedureReady = executeSQL(dbc, upsertProcedure);
+    if (!upsertProcedureReady) {
+        logError(L"[Database] integrate_file_record is not available, records are integrated statement by statement", LOG_PATH);
+    }
+
+    // Block numbers of the client-side data ids, starting after the rows that already exist
+    std::wstringstream idSequence;
+    idSequence << L"IF OBJECT_ID(N'[data_id_hi]', N'SO') IS NULL "
+        << L"BEGIN "
+        << L"DECLARE @start BIGINT = ISNULL(IDENT_CURRENT(N'data'), 0) / " << DATA_ID_BLOCK_SIZE << L" + 1; "
+        << L"EXEC (N'CREATE SEQUENCE [data_id_hi] AS BIGINT START WITH ' + CAST(@start AS NVARCHAR(20)) + N' INCREMENT BY 1'); "
+        << L"END";
+    bool sequenceReady = executeSQL(dbc, idSequence);
+
+    return upsertProcedureReady && sequenceReady;
+}
+
 // Method of disconnecting from the database
 void Database::disconnectFromDatabase() {
     try {
         if (dbc != SQL_NULL_HDBC) {
+            // Prepared statements belong to the connection and are freed before it
+            StatementCache::release(dbc);
             SQLRETURN ret = SQLDisconnect(dbc);
             if (!SQL_SUCCEEDED(ret)) {
                 logError(L"Failed to disconnect from database", LOG_PATH);
@@ -0,0 +1,155 @@
+#include "directory_scanner.h"
+#include <thread>
+#include <boost/algorithm/string/predicate.hpp>
+#include "utils.h"
+#include "metrics.h"
+
+DirectoryScanner::DirectoryScanner(size_t threads, std::vector<std::wstring> skippedNames)
+    : threads(threads ? threads : 1), skippedNames(std::move(skippedNames))
+{
+}
+
+size_t DirectoryScanner::scan(const std::wstring& rootFolder, const Visitor& visitor)
+{
+    boost::system::error_code ec;
+    if (!fs::is_directory(rootFolder, ec)) {
+        logError(L"The folder does not exist or is inaccessible: " + rootFolder, INTEGRATION_LOG_PATH);
+        return 0;
+    }
+
+    BoundedQueue<fs::directory_entry> found(fileQueueCapacity);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        directories.clear();
+        visited.clear();
+        outstanding = 0;
+        stopped = false;
+        files = &found;
+    }
+    listedDirectories = 0;
+    runningThreads = threads;
+    enqueueDirectory(rootFolder);
+
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < threads; ++i) {
+        pool.emplace_back([this] {
+            listDirectories();
+            // The last listing thread tells the visitor loop that nothing more is coming
+            if (--runningThreads == 0) {
+                files->close();
+            }
+            });
+    }
+
+    size_t delivered = 0;
+    try {
+        fs::directory_entry entry;
+        while (found.pop(entry)) {
+            ++delivered;
+            if (!visitor(entry)) {
+                stop();
+                break;
+            }
+        }
+    }
+    catch (...) {
+        stop();
+        for (auto& thread : pool) {
+            thread.join();
+        }
+        throw;
+    }
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    files = nullptr;
+
+    Metrics::getInstance().add("scanner.directories", listedDirectories);
+    Metrics::getInstance().add("scanner.files", delivered);
+    return delivered;
+}
+
+void DirectoryScanner::listDirectories()
+{
+    while (true) {
+        fs::path directory;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            directoryReady.wait(lock, [this] { return stopped || !directories.empty() || outstanding == 0; });
+            if (stopped || directories.empty()) {
+                return;
+            }
+            directory = std::move(directories.front());
+            directories.pop_front();
+        }
+
+        boost::system::error_code ec;
+        fs::directory_iterator it(directory, ec);
+        if (ec) {
+            logError(L"Directory could not be listed: " + directory.wstring() + L" " + stringToWString(ec.message()), INTEGRATION_LOG_PATH);
+        }
+        for (; !ec && it != fs::directory_iterator() && !stopped; it.increment(ec)) {
+            fs::file_status status = it->status(ec);
+            if (ec) {
+                // A file removed while listing, the rest of the directory is still valid
+                ec.clear();
+                continue;
+            }
+
+            if (fs::is_directory(status)) {
+                if (!isSkipped(it->path())) {
+                    enqueueDirectory(it->path());
+                }
+            }
+            else if (fs::is_regular_file(status)) {
+                // Closed only when the visitor stopped the scan
+                if (!files->push(*it)) {
+                    break;
+                }
+            }
+        }
+        ++listedDirectories;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--outstanding == 0) {
+            directoryReady.notify_all();
+        }
+    }
+}
+
+void DirectoryScanner::enqueueDirectory(const fs::path& path)
+{
+    boost::system::error_code ec;
+    fs::path canonical = fs::canonical(path, ec);
+    std::wstring key = ec ? path.wstring() : canonical.wstring();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!visited.insert(key).second) {
+        return;
+    }
+    directories.push_back(path);
+    ++outstanding;
+    directoryReady.notify_one();
+}
+
+bool DirectoryScanner::isSkipped(const fs::path& path) const
+{
+    std::wstring name = path.filename().wstring();
+    for (const auto& skipped : skippedNames) {
+        if (boost::iequals(name, skipped)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void DirectoryScanner::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+    }
+    directoryReady.notify_all();
+    files->close();
+}
@@ -0,0 +1,218 @@
+#include "express_header.h"
+#include <cstring>
+#include "cp866_decoder.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define EXPRESS_HEADER_SSE2
+#endif
+
+namespace {
+
+// Markers in CP866
+const char DATE_MARKER[] = "\x84\xa0\xe2\xa0";                                 // ""
+const char TIME_MARKER[] = "\x82\xe0\xa5\xac\xef";                             // ""
+const char START_WORD[] = "\xaf\xe3\xe1\xaa\xa0";                              // ""
+const char FACTOR_MARKER[] = "\x94\xa0\xaa\xe2\xae\xe0 \xaf\xe3\xe1\xaa\xa0:"; // " :"
+const char FAULT_MARKER[] = "\x8f\xae\xa2\xe0\xa5\xa6\xa4\xa5\xad\xa8\xa5";    // ""
+const char DAMAGED_LINE_MARKER[] =                                             // " , :"
+    "\x8f\xae\xa2\xe0\xa5\xa6\xa4\xa5\xad\xad\xa0\xef \xab\xa8\xad\xa8\xef, "
+    "\xaf\xe0\xa5\xa4\xaf\xae\xab\xae\xa6\xa8\xe2\xa5\xab\xec\xad\xae:";
+
+// First bytes of the markers, every other byte is skipped without a look
+const unsigned char LEAD_BYTES[] = { 0x84, 0x82, 0x94, 0x8f, '$' };
+
+struct HeaderScanner {
+    HeaderScanner(const char* data, size_t size)
+        : data(data), size(size) {}
+
+    // Position of the next byte that may start a marker, size if there is none
+    size_t nextLead(size_t from) const {
+#ifdef EXPRESS_HEADER_SSE2
+        const __m128i lead0 = _mm_set1_epi8(static_cast<char>(LEAD_BYTES[0]));
+        const __m128i lead1 = _mm_set1_epi8(static_cast<char>(LEAD_BYTES[1]));
+        const __m128i lead2 = _mm_set1_epi8(static_cast<char>(LEAD_BYTES[2]));
+        const __m128i lead3 = _mm_set1_epi8(static_cast<char>(LEAD_BYTES[3]));
+        const __m128i lead4 = _mm_set1_epi8(static_cast<char>(LEAD_BYTES[4]));
+        while (from + 16 <= size) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + from));
+            __m128i hits = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, lead0), _mm_cmpeq_epi8(chunk, lead1)),
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, lead2), _mm_cmpeq_epi8(chunk, lead3)),
+                    _mm_cmpeq_epi8(chunk, lead4)));
+            int mask = _mm_movemask_epi8(hits);
+            if (mask != 0) {
+                while ((mask & 1) == 0) {
+                    mask >>= 1;
+                    ++from;
+                }
+                return from;
+            }
+            from += 16;
+        }
+#endif
+        for (; from < size; ++from) {
+            if (std::memchr(LEAD_BYTES, static_cast<unsigned char>(data[from]), sizeof(LEAD_BYTES))) {
+                return from;
+            }
+        }
+        return size;
+    }
+
+    // Marker text at the position, the terminating zero of the literal is not compared
+    template <size_t N>
+    bool startsWith(size_t pos, const char (&marker)[N]) const {
+        return pos + N - 1 <= size && std::memcmp(data + pos, marker, N - 1) == 0;
+    }
+
+    // \s of the former patterns, the file is CP866 so only ASCII spaces are possible
+    bool isSpace(size_t pos) const {
+        char c = data[pos];
+        return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+    }
+
+    bool isDigit(size_t pos) const {
+        return data[pos] >= '0' && data[pos] <= '9';
+    }
+
+    size_t skipSpaces(size_t pos) const {
+        while (pos < size && isSpace(pos)) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    // The line terminators "." of the former patterns did not cross
+    size_t lineEnd(size_t pos) const {
+        while (pos < size && data[pos] != '\n' && data[pos] != '\r') {
+            ++pos;
+        }
+        return pos;
+    }
+
+    // Digits and separators like "dd/dd/dddd", 'd' stands for a digit
+    bool matchesShape(size_t pos, const char* shape) const {
+        size_t length = std::strlen(shape);
+        if (pos + length > size) {
+            return false;
+        }
+        for (size_t i = 0; i < length; ++i) {
+            if (shape[i] == 'd' ? !isDigit(pos + i) : data[pos + i] != shape[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Dd/dd/dddd or dd:dd:dd.ddd after optional spaces, an optional colon and optional spaces
+    bool valueAfterLabel(size_t pos, const char* shape, std::wstring& value) const {
+        pos = skipSpaces(pos);
+        if (pos < size && data[pos] == ':') {
+            pos = skipSpaces(pos + 1);
+        }
+        if (!matchesShape(pos, shape)) {
+            return false;
+        }
+        value = decode(pos, pos + std::strlen(shape));
+        return true;
+    }
+
+    // Rest of the line after the spaces that follow a label
+    std::wstring restOfLine(size_t pos) const {
+        pos = skipSpaces(pos);
+        return decode(pos, lineEnd(pos));
+    }
+
+    // Up to the next '$' or the end of the file, like extractParamValue
+    std::wstring paramValue(size_t pos) const {
+        const void* end = std::memchr(data + pos, '$', size - pos);
+        return decode(pos, end ? static_cast<const char*>(end) - data : size);
+    }
+
+    std::wstring decode(size_t begin, size_t end) const {
+        if (begin >= end) {
+            return std::wstring();
+        }
+        return Cp866Decoder::forThisThread().toWide(data + begin, end - begin);
+    }
+
+    const char* data;
+    size_t size;
+};
+
+} // namespace
+
+ExpressHeader parseExpressHeader(const char* content, size_t size)
+{
+    ExpressHeader header;
+    HeaderScanner scanner(content, size);
+
+    bool hasDate = false, hasTime = false, hasFactor = false, hasTypeKz = false, hasDamagedLine = false;
+    size_t paramDate = std::string::npos, paramTime = std::string::npos;
+    size_t paramFactor = std::string::npos, paramLineFault = std::string::npos;
+
+    for (size_t pos = scanner.nextLead(0); pos < scanner.size; pos = scanner.nextLead(pos + 1)) {
+        switch (static_cast<unsigned char>(content[pos])) {
+        case 0x84:
+            if (!hasDate && scanner.startsWith(pos, DATE_MARKER)) {
+                hasDate = scanner.valueAfterLabel(pos + sizeof(DATE_MARKER) - 1, "dd/dd/dddd", header.date);
+            }
+            break;
+
+        case 0x82:
+            if (!hasTime && scanner.startsWith(pos, TIME_MARKER)) {
+                // " " or just ""
+                size_t label = pos + sizeof(TIME_MARKER) - 1;
+                size_t word = scanner.skipSpaces(label);
+                if (word > label && scanner.startsWith(word, START_WORD)) {
+                    label = word + sizeof(START_WORD) - 1;
+                }
+                hasTime = scanner.valueAfterLabel(label, "dd:dd:dd.ddd", header.time);
+            }
+            break;
+
+        case 0x94:
+            if (!hasFactor && scanner.startsWith(pos, FACTOR_MARKER)) {
+                header.factor = scanner.restOfLine(pos + sizeof(FACTOR_MARKER) - 1);
+                hasFactor = true;
+            }
+            break;
+
+        case 0x8f:
+            if (!hasDamagedLine && scanner.startsWith(pos, DAMAGED_LINE_MARKER)) {
+                header.damagedLine = scanner.restOfLine(pos + sizeof(DAMAGED_LINE_MARKER) - 1);
+                hasDamagedLine = true;
+            }
+            else if (!hasTypeKz && scanner.startsWith(pos, FAULT_MARKER)) {
+                // The value follows the last colon of the line
+                size_t end = scanner.lineEnd(pos);
+                for (size_t colon = end; colon > pos + sizeof(FAULT_MARKER) - 1; --colon) {
+                    if (content[colon - 1] == ':') {
+                        header.typeKz = scanner.restOfLine(colon);
+                        hasTypeKz = true;
+                        break;
+                    }
+                }
+            }
+            break;
+
+        case '$':
+            if (scanner.startsWith(pos, "$DP=")) paramDate = pos + 4;
+            else if (scanner.startsWith(pos, "$TP=")) paramTime = pos + 4;
+            else if (scanner.startsWith(pos, "$SF=")) paramFactor = pos + 4;
+            else if (scanner.startsWith(pos, "$LF=")) paramLineFault = pos + 4;
+            break;
+        }
+
+        // The parameters are only read when a line is missing, the rest of the file does not matter then
+        if (hasDamagedLine && !header.date.empty() && !header.time.empty() && !header.factor.empty() && !header.typeKz.empty()) {
+            break;
+        }
+    }
+
+    if (paramDate != std::string::npos) header.paramDate = scanner.paramValue(paramDate);
+    if (paramTime != std::string::npos) header.paramTime = scanner.paramValue(paramTime);
+    if (paramFactor != std::string::npos) header.paramFactor = scanner.paramValue(paramFactor);
+    if (paramLineFault != std::string::npos) header.paramLineFault = scanner.paramValue(paramLineFault);
+    return header;
+}
@@ -0,0 +1,233 @@
+#include "file_catalog.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <openssl/evp.h>
+#include "utils.h"
+#include "metrics.h"
+#include "file_view.h"
+
+void FileCatalog::load(const std::string& logPath)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->logPath = logPath;
+    entries.clear();
+    uncommitted.clear();
+    logLines = 0;
+
+    std::ifstream input(logPath, std::ios::binary);
+    if (!input) {
+        return;
+    }
+
+    // A later line of a path replaces the earlier one, a torn last line is ignored
+    std::string line;
+    while (std::getline(input, line)) {
+        ++logLines;
+        std::wstring key;
+        Entry entry;
+        if (parseLine(line, key, entry)) {
+            entries[key] = entry;
+        }
+    }
+    input.close();
+
+    if (logLines > entries.size() * 2 + 1000) {
+        compact();
+    }
+    logError(L"[Catalog] " + std::to_wstring(entries.size()) + L" integrated files known", INTEGRATION_LOG_PATH);
+}
+
+bool FileCatalog::isIntegrated(const fs::directory_entry& entry)
+{
+    std::wstring key = keyOf(entry.path());
+    Entry stored;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            return false;
+        }
+        stored = it->second;
+    }
+
+    boost::system::error_code ec;
+    uint64_t size = fs::file_size(entry.path(), ec);
+    if (ec || size != stored.size) {
+        return false;
+    }
+    int64_t modified = static_cast<int64_t>(fs::last_write_time(entry.path(), ec));
+    if (ec) {
+        return false;
+    }
+
+    if (modified != stored.modified) {
+        std::string hash = hashFile(entry.path().wstring());
+        if (hash.empty() || hash != stored.hash) {
+            return false;
+        }
+
+        // Copied or touched only, the new time spares the hash next time
+        stored.modified = modified;
+        std::lock_guard<std::mutex> lock(mutex);
+        entries[key] = stored;
+        uncommitted.push_back(formatLine(key, stored));
+    }
+
+    Metrics::getInstance().add("catalog.skipped");
+    return true;
+}
+
+void FileCatalog::markIntegrated(const std::wstring& path)
+{
+    boost::system::error_code ec;
+    Entry entry;
+    entry.size = fs::file_size(path, ec);
+    if (!ec) {
+        entry.modified = static_cast<int64_t>(fs::last_write_time(path, ec));
+    }
+    if (ec) {
+        logError(L"[Catalog] Failed to read attributes of " + path + L": " + stringToWString(ec.message()), INTEGRATION_LOG_PATH);
+        return;
+    }
+    entry.hash = hashFile(path);
+    if (entry.hash.empty()) {
+        return;
+    }
+
+    std::wstring key = keyOf(path);
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[key] = entry;
+    uncommitted.push_back(formatLine(key, entry));
+}
+
+void FileCatalog::commit()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (uncommitted.empty()) {
+        return;
+    }
+
+    std::ofstream output(logPath, std::ios::binary | std::ios::app);
+    for (const auto& line : uncommitted) {
+        output << line;
+    }
+    output.flush();
+    if (!output) {
+        // Kept for the next commit, the files are integrated again after a restart at worst
+        logError(L"[Catalog] Failed to write " + stringToWString(logPath), INTEGRATION_LOG_PATH);
+        return;
+    }
+
+    logLines += uncommitted.size();
+    Metrics::getInstance().add("catalog.committed", uncommitted.size());
+    uncommitted.clear();
+}
+
+void FileCatalog::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    uncommitted.clear();
+    logLines = 0;
+
+    std::ofstream output(logPath, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        logError(L"[Catalog] Failed to clear " + stringToWString(logPath), INTEGRATION_LOG_PATH);
+    }
+}
+
+void FileCatalog::compact()
+{
+    const std::string tempPath = logPath + ".tmp";
+    {
+        std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+        for (const auto& entry : entries) {
+            output << formatLine(entry.first, entry.second);
+        }
+        output.flush();
+        if (!output) {
+            logError(L"[Catalog] Failed to compact " + stringToWString(logPath), INTEGRATION_LOG_PATH);
+            return;
+        }
+    }
+
+    boost::system::error_code ec;
+    fs::rename(tempPath, logPath, ec);
+    if (ec) {
+        logError(L"[Catalog] Failed to replace " + stringToWString(logPath) + L": " + stringToWString(ec.message()), INTEGRATION_LOG_PATH);
+        return;
+    }
+    logLines = entries.size();
+}
+
+std::wstring FileCatalog::keyOf(const fs::path& path)
+{
+    // Paths built with either separator name the same file
+    fs::path normal = path.lexically_normal();
+    normal.make_preferred();
+    return normal.wstring();
+}
+
+std::string FileCatalog::hashFile(const std::wstring& path)
+{
+    // Hashed straight from the mapped pages
+    FileView view(path);
+    if (!view.valid()) {
+        return std::string();
+    }
+
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (!ctx || EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) != 1 ||
+        EVP_DigestUpdate(ctx, view.data(), view.size()) != 1) {
+        EVP_MD_CTX_free(ctx);
+        return std::string();
+    }
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    bool finished = EVP_DigestFinal_ex(ctx, digest, &length) == 1;
+    EVP_MD_CTX_free(ctx);
+    if (!finished) {
+        return std::string();
+    }
+
+    std::ostringstream hex;
+    for (unsigned int i = 0; i < length; ++i) {
+        hex << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(digest[i]);
+    }
+    return hex.str();
+}
+
+std::string FileCatalog::formatLine(const std::wstring& key, const Entry& entry)
+{
+    // hash <TAB> size <TAB> modification time <TAB> path (UTF-8)
+    return entry.hash + "\t" + std::to_string(entry.size) + "\t" + std::to_string(entry.modified) + "\t" +
+        wstringToUtf8(key) + "\n";
+}
+
+bool FileCatalog::parseLine(const std::string& line, std::wstring& key, Entry& entry)
+{
+    size_t first = line.find('\t');
+    size_t second = first == std::string::npos ? first : line.find('\t', first + 1);
+    size_t third = second == std::string::npos ? second : line.find('\t', second + 1);
+    if (third == std::string::npos || third + 1 >= line.size()) {
+        return false;
+    }
+
+    try {
+        entry.hash = line.substr(0, first);
+        entry.size = std::stoull(line.substr(first + 1, second - first - 1));
+        entry.modified = std::stoll(line.substr(second + 1, third - second - 1));
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+
+    std::string path = line.substr(third + 1);
+    if (!path.empty() && path.back() == '\r') {
+        path.pop_back();
+    }
+    key = utf8_to_wstring(path);
+    return !entry.hash.empty() && !key.empty();
+}
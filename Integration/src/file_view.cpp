@@ -0,0 +1,153 @@
+#include "file_view.h"
+#include <algorithm>
+#include <utility>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+#endif
+
+FileView::FileView(FileView&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+FileView& FileView::operator=(FileView&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        std::swap(begin, other.begin);
+        std::swap(length, other.length);
+        std::swap(mapped, other.mapped);
+        buffer.swap(other.buffer);
+        // A short buffer keeps its bytes inside the string object
+        if (!mapped && begin != nullptr) {
+            begin = buffer.data();
+        }
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+// Pages of fixed and RAM disks come in unless the disk itself fails
+static bool isLocalVolume(const std::wstring& path)
+{
+    std::vector<wchar_t> volume(path.size() + MAX_PATH);
+    if (!GetVolumePathNameW(path.c_str(), volume.data(), static_cast<DWORD>(volume.size()))) {
+        return false;
+    }
+    UINT type = GetDriveTypeW(volume.data());
+    return type == DRIVE_FIXED || type == DRIVE_RAMDISK;
+}
+
+// Whole file into the buffer through the open handle
+static bool readWhole(HANDLE file, std::string& buffer, size_t size)
+{
+    buffer.resize(size);
+    size_t offset = 0;
+    while (offset < size) {
+        DWORD chunk = static_cast<DWORD>((std::min)(size - offset, static_cast<size_t>(1 << 30)));
+        DWORD read = 0;
+        if (!ReadFile(file, &buffer[offset], chunk, &read, nullptr) || read == 0) {
+            buffer.clear();
+            return false;
+        }
+        offset += read;
+    }
+    return true;
+}
+#endif
+
+bool FileView::open(const std::wstring& path)
+{
+    close();
+
+#ifdef _WIN32
+    // The place stage may move the file while its content is being uploaded. A file still being
+    // written is refused, its mapped pages could change or disappear under the reader
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    if (!isLocalVolume(path)) {
+        // A failed read is an error code here, not an exception in the middle of the parser or the driver
+        bool read = readWhole(file, buffer, static_cast<size_t>(fileSize.QuadPart));
+        CloseHandle(file);
+        if (!read) {
+            return false;
+        }
+        begin = buffer.data();
+        length = buffer.size();
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return false;
+    }
+
+    // The view keeps the mapping and the file open by itself
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == nullptr) {
+        return false;
+    }
+    begin = static_cast<const char*>(view);
+    length = static_cast<size_t>(fileSize.QuadPart);
+    mapped = true;
+#else
+    int fd = ::open(boost::filesystem::path(path).string().c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    begin = static_cast<const char*>(view);
+    length = static_cast<size_t>(status.st_size);
+    mapped = true;
+#endif
+    return true;
+}
+
+void FileView::close()
+{
+    if (begin == nullptr) {
+        return;
+    }
+    if (mapped) {
+#ifdef _WIN32
+        UnmapViewOfFile(begin);
+#else
+        munmap(const_cast<char*>(begin), length);
+#endif
+    }
+    std::string().swap(buffer);
+    begin = nullptr;
+    length = 0;
+    mapped = false;
+}
@@ -2,6 +2,9 @@
 #include "db_connection.h"
 #include "integration_handler.h"
 #include "utils.h"
+#include "metrics.h"
+#include "ftp_inbox.h"
+#include "file_name.h"
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
 
@@ -45,109 +48,217 @@ size_t Ftp::write_data(void* ptr, size_t size, size_t nmemb, FILE* stream) {
     if (written != size * nmemb) {
         logError(L"[FTP1]: Error writing to file. Written: " + stringToWString(std::to_string(written)), FTP_LOG_PATH);
     }
+    Metrics::getInstance().add("ftp.bytes_downloaded", written);
     return written;
 }
 
-// Callback function to display the file table
-size_t Ftp::write_list_stream(void* buffer, size_t size, size_t nmemb, void* userp) {
-    if (!buffer || !userp) {
-        logError(L"write_list_stream: NULL pointer detected!", FTP_LOG_PATH);
-        return 0;
-    }
-
-    FtpTransferContext* context = static_cast<FtpTransferContext*>(userp);
-    const size_t totalSize = size * nmemb;
-    const char* data = static_cast<char*>(buffer);
+bool startsWithValidPrefix(const std::string& fileName) {
+    return parseFileName(fileName).valid();
+}
 
-    size_t processed = 0;
-    while (processed < totalSize && context->processedFiles < context->maxFilesPerSession) {
-        const char* end = static_cast<const char*>(memchr(data + processed, '\n', totalSize - processed));
-        if (!end) break;
+bool Ftp::writeMetaFile(const std::string& fileName, const ServerInfo& server, const std::wstring& ftpCacheDirPath)
+{
+    json j = {
+        {"targetPath", wstringToUtf8(server.localFolderPath)}
+    };
 
-        size_t lineLength = end - (data + processed);
-        std::string filename(data + processed, lineLength);
-        processed += lineLength + 1;
+    std::string jsonInfo = j.dump(4);
 
-        filename.erase(filename.find_last_not_of("\r\n") + 1);
-        if (filename.empty()) continue;
+    // Written under a temporary name, a reader never sees half of the JSON
+    std::string metaPath = wstringToString(ftpCacheDirPath) + "/" + fileName + ".meta";
+    std::string tempPath = metaPath + wstringToString(FTP_PARTIAL_SUFFIX);
 
-        // We pass the entire context to the handler
-        Ftp::getInstance().processSingleFile(filename, *context);
+    std::ofstream metaFile(tempPath, std::ios::trunc);
+    if (!metaFile.is_open()) {
+        logError(L"[FTP] Failed to create meta file for " + stringToWString(fileName), FTP_LOG_PATH);
+        return false;
+    }
+    metaFile << jsonInfo;
+    metaFile.close();
+    if (!metaFile) {
+        logError(L"[FTP] Failed to write meta file for " + stringToWString(fileName), FTP_LOG_PATH);
+        return false;
     }
 
-    return totalSize;
+    boost::system::error_code ec;
+    fs::rename(tempPath, metaPath, ec);
+    if (ec) {
+        logError(L"[FTP] Failed to publish meta file for " + stringToWString(fileName) + L": " + utf8_to_wstring(ec.message()), FTP_LOG_PATH);
+        return false;
+    }
+    return true;
 }
 
-bool startsWithValidPrefix(const std::string& fileName) {
-    std::vector<std::string> validPrefixes = {
-    "REXPR", "RECON", "RNET", "RPUSK", "DAILY", "DIAGN"
-    };
+std::wstring Ftp::partialPath(const std::string& fileName, const std::wstring& ftpCacheDirPath)
+{
+    return ftpCacheDirPath + L"/" + stringToWString(fileName) + FTP_PARTIAL_SUFFIX;
+}
 
-    return std::any_of(validPrefixes.begin(), validPrefixes.end(),
-        [&](const std::string& prefix) {
-            return fileName.rfind(prefix, 0) == 0;
-        });
+uintmax_t Ftp::partialSize(const std::wstring& partPath)
+{
+    boost::system::error_code ec;
+    uintmax_t size = fs::file_size(partPath, ec);
+    return ec ? 0 : size;
 }
 
-void Ftp::processSingleFile(const std::string& fileName, FtpTransferContext& context) {
-    if (!startsWithValidPrefix(fileName) ||
-        !context.ftpIsActive->load(std::memory_order_acquire)) {
+void Ftp::keepPartial(const std::wstring& partPath, CURLcode result)
+{
+    boost::system::error_code ec;
+    // The local part is longer than the remote file, it belongs to another file of the same name
+    if (result == CURLE_BAD_DOWNLOAD_RESUME || partialSize(partPath) == 0) {
+        fs::remove(partPath, ec);
         return;
     }
+    logError(L"[FTP] Partial download kept for resumption: " + partPath, FTP_LOG_PATH);
+}
 
-    try {
-        if (downloadFile(fileName, *context.server, context.url + fileName, context.ftpCacheDirPath)) {
-            deleteFile(fileName, *context.server, context.url);
+bool Ftp::verifyDownloadSize(const std::wstring& partPath, const FtpSession& session)
+{
+    curl_off_t expected = session.expectedSize();
+    if (expected < 0) {
+        // No SIZE support on the recorder, libcurl has nothing to compare either
+        return true;
+    }
+
+    uintmax_t actual = partialSize(partPath);
+    if (actual != static_cast<uintmax_t>(expected)) {
+        logError(L"[FTP] Downloaded size " + std::to_wstring(actual) + L" differs from the remote size " +
+            std::to_wstring(expected) + L", discarding " + partPath, FTP_LOG_PATH);
+        boost::system::error_code ec;
+        fs::remove(partPath, ec);
+        return false;
+    }
+    return true;
+}
 
-            // Forming a path for OneDrive
-            std::wstring unitW = context.server->unit;
-            std::wstring firstPart, secondPart;
+void Ftp::removeStalePartials(const std::wstring& ftpCacheDirPath, std::chrono::seconds maxAge)
+{
+    boost::system::error_code ec;
+    const std::time_t limit = std::time(nullptr) - static_cast<std::time_t>(maxAge.count());
+    for (fs::directory_iterator it(ftpCacheDirPath, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() != FTP_PARTIAL_SUFFIX) {
+            continue;
+        }
+        boost::system::error_code timeEc;
+        std::time_t lastWrite = fs::last_write_time(it->path(), timeEc);
+        if (!timeEc && lastWrite < limit) {
+            boost::system::error_code removeEc;
+            fs::remove(it->path(), removeEc);
+        }
+    }
+}
 
-            size_t separatorPos = unitW.find(L" - ");
-            if (separatorPos != std::wstring::npos) {
-                firstPart = unitW.substr(0, separatorPos);
-                secondPart = unitW.substr(separatorPos + 3);
-            }
-            else {
-                firstPart = unitW;
-            }
+bool Ftp::publishDownload(const std::string& fileName, const ServerInfo& server, const std::wstring& ftpCacheDirPath)
+{
+    // The Cache consumer picks up data files only, so the sidecar is already there when it sees one
+    if (!writeMetaFile(fileName, server, ftpCacheDirPath)) {
+        return false;
+    }
 
-            std::wstring oneDriveFullPathToFile = context.oneDrivePath + L"/" + firstPart + L"/" +
-                (secondPart.empty() ? L"" : secondPart + L"/") +
-                context.server->substation + L"/" + context.server->object + L"/" +
-                stringToWString(fileName);
+    boost::system::error_code ec;
+    fs::rename(partialPath(fileName, ftpCacheDirPath), ftpCacheDirPath + L"/" + stringToWString(fileName), ec);
+    if (ec) {
+        logError(L"[FTP] Failed to publish downloaded file " + stringToWString(fileName) + L": " + utf8_to_wstring(ec.message()), FTP_LOG_PATH);
+        return false;
+    }
+    return true;
+}
 
-            if (context.oneDriveIsActive->load(std::memory_order_acquire)) {
-                if (oneDriveFullPathToFile.length() >= 260) {
-                    logError(L"[OneDrive] Path too long, file skipped: " + oneDriveFullPathToFile, ONEDRIVE_LOG_PATH);
-                    return;
-                }
+bool Ftp::writeBufferToFile(const std::wstring& filePath, const std::string& data)
+{
+    FILE* file = _wfopen(filePath.c_str(), L"wb");
+    if (!file) {
+        logError(L"[FTP] Error opening file for writing: " + filePath, FTP_LOG_PATH);
+        return false;
+    }
 
-                if (!fs::exists(oneDriveFullPathToFile)) {
-                    fs::copy_file(fs::path(context.ftpCacheDirPath) / fileName,
-                        oneDriveFullPathToFile,
-                        fs::copy_options::overwrite_existing);
-                    logError(L"[OneDrive] File copied successfully: " + oneDriveFullPathToFile, ONEDRIVE_LOG_PATH);
-                }
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    written = (fclose(file) == 0) && written;
+    if (!written) {
+        logError(L"[FTP] Error writing file: " + filePath, FTP_LOG_PATH);
+    }
+    return written;
+}
+
+std::wstring Ftp::storeHarvestedFile(const HarvestedFile& file, const std::wstring& ftpCacheDirPath, bool& storedInCache)
+{
+    storedInCache = false;
+
+    // Final location: written under a temporary name and renamed, scanners never see a half file
+    const std::wstring targetFolder = file.server.localFolderPath;
+    boost::system::error_code ec;
+    if (!targetFolder.empty() && fs::exists(targetFolder, ec)) {
+        std::wstring targetPath = targetFolder + L"/" + stringToWString(file.fileName);
+        std::wstring tempPath = targetPath + FTP_PARTIAL_SUFFIX;
+
+        if (writeBufferToFile(tempPath, file.data)) {
+            if (file.modificationTime >= 0) {
+                setFileTime(tempPath, file.modificationTime);
+            }
+            fs::rename(tempPath, targetPath, ec);
+            if (!ec) {
+                return targetPath;
             }
+            logError(L"[FTP] Failed to publish handed over file " + targetPath + L": " + utf8_to_wstring(ec.message()), FTP_LOG_PATH);
         }
+        fs::remove(tempPath, ec);
     }
-    catch (const fs::filesystem_error& e) {
-        std::wstring errorMessage = L"[FTP] Filesystem error processing " +
-            stringToWString(fileName) + L": " +
-            utf8_to_wstring(e.what());
-        logError(errorMessage, EXCEPTION_LOG_PATH);
+    else {
+        logError(L"[FTP] Target folder of handed over file was not found, using Cache: " + targetFolder, FTP_LOG_PATH);
     }
-    catch (const std::exception& e) {
-        logError(stringToWString("[FTP] Error processing ") +
-            stringToWString(fileName) + L": " +
-            stringToWString(e.what()), EXCEPTION_LOG_PATH);
+
+    // Fallback: the usual Cache entry with its sidecar
+    std::wstring partPath = partialPath(file.fileName, ftpCacheDirPath);
+    if (!writeBufferToFile(partPath, file.data)) {
+        fs::remove(partPath, ec);
+        return std::wstring();
     }
+    if (file.modificationTime >= 0) {
+        setFileTime(partPath, file.modificationTime);
+    }
+    if (!publishDownload(file.fileName, file.server, ftpCacheDirPath)) {
+        return std::wstring();
+    }
+
+    storedInCache = true;
+    return ftpCacheDirPath + L"/" + stringToWString(file.fileName);
 }
 
+void Ftp::copyToOneDrive(const std::string& fileName, const ServerInfo& server, const std::wstring& oneDrivePath, const std::wstring& sourceFile)
+{
+    // Forming a path for OneDrive
+    std::wstring unitW = server.unit;
+    std::wstring firstPart, secondPart;
+
+    size_t separatorPos = unitW.find(L" - ");
+    if (separatorPos != std::wstring::npos) {
+        firstPart = unitW.substr(0, separatorPos);
+        secondPart = unitW.substr(separatorPos + 3);
+    }
+    else {
+        firstPart = unitW;
+    }
+
+    std::wstring oneDriveFullPathToFile = oneDrivePath + L"/" + firstPart + L"/" +
+        (secondPart.empty() ? L"" : secondPart + L"/") +
+        server.substation + L"/" + server.object + L"/" +
+        stringToWString(fileName);
+
+    if (oneDriveFullPathToFile.length() >= 260) {
+        logError(L"[OneDrive] Path too long, file skipped: " + oneDriveFullPathToFile, ONEDRIVE_LOG_PATH);
+        return;
+    }
+
+    if (!fs::exists(oneDriveFullPathToFile)) {
+        fs::copy_file(sourceFile,
+            oneDriveFullPathToFile,
+            fs::copy_options::overwrite_existing);
+        logError(L"[OneDrive] File copied successfully: " + oneDriveFullPathToFile, ONEDRIVE_LOG_PATH);
+    }
+}
 
 // Method of collecting servers from a database
-void Ftp::collectServers(std::vector<ServerInfo>& servers, SQLHDBC dbc) {
+void Ftp::collectServers(std::vector<ServerInfo>& servers, SQLHDBC dbc, long probeDeadlineMs) {
     //logFtpError(L"[FTP] Starting collectServers...");
     SQLHSTMT stmt = SQL_NULL_HSTMT;
     try {
@@ -217,19 +328,6 @@ void Ftp::collectServers(std::vector<ServerInfo>& servers, SQLHDBC dbc) {
 
             server.remoteFolderPath = (remoteFolderPathLen != SQL_NULL_DATA) ? remoteFolderPath : L"";
 
-            //logFtpError(L"[FTP] Checking connection for IP: " + server.ip + L"/" + server.remoteFolderPath + L"/");
-            if (status == 1) {
-                std::wstring url = Ftp::protocol() + server.ip + L"/" + server.remoteFolderPath + L"/";
-                if (!checkConnection(wstringToString(url), wstringToString(server.login), wstringToString(server.pass))) {
-                    //logFtpError(L"[FTP] Connection failed for " + server.ip + L"/" + server.remoteFolderPath + L"/");
-                    continue;
-                }
-                auto now = std::chrono::system_clock::now();
-                server.lastPingTime = std::chrono::system_clock::to_time_t(now); 
-                Ftp::getInstance().pingServer(server.reconId, server.lastPingTime);
-				logError(L"[FTP] Connection successful for " + server.ip + L"/" + server.remoteFolderPath + L"/", FTP_LOG_PATH);
-            }
-
             server.unit = (unitLen != SQL_NULL_DATA) ? unit : L"";
             server.substation = (substationLen != SQL_NULL_DATA) ? substation : L"";
             server.object = (objectLen != SQL_NULL_DATA) ? object : L"";
@@ -252,232 +350,165 @@ cleanup:
     SQLFreeStmt(stmt, SQL_CLOSE);
     SQLFreeHandle(SQL_HANDLE_STMT, stmt);
     //logFtpError(L"[FTP] collectServers completed.");
+
+    // Directories that are not due yet are not even probed
+    servers.erase(std::remove_if(servers.begin(), servers.end(), [this](const ServerInfo& server) {
+        return !scheduler.isDue(pollKey(server));
+        }), servers.end());
+
+    // The cursor is already closed, probing does not hold the database
+    probeServers(servers, probeDeadlineMs);
 }
 
-void Ftp::setFileTime(const std::string& filePath, const std::string& timestamp)
+std::string Ftp::pollKey(const ServerInfo& server)
 {
-    SYSTEMTIME sysTime = {};
-    FILETIME fileTime = {};
-
-    // Parse the timestamp string (format: "YYYY-MM-DD HH:MM:SS")
-    if (sscanf(timestamp.c_str(), "%hd-%hd-%hd %hd:%hd:%hd",
-        &sysTime.wYear, &sysTime.wMonth, &sysTime.wDay,
-        &sysTime.wHour, &sysTime.wMinute, &sysTime.wSecond) != 6)
-    {
-        logError(L"Invalid timestamp format: " + stringToWString(timestamp), FTP_LOG_PATH);
-        return;
-    }
-
+    return wstringToString(server.ip) + "/" + wstringToString(server.remoteFolderPath);
+}
 
-    // Convert SYSTEMTIME to FILETIME
-    if (!SystemTimeToFileTime(&sysTime, &fileTime))
-    {
-        logError(L"Failed to convert system time to file time", FTP_LOG_PATH);
+// Checking all servers concurrently, the whole stage takes at most one deadline
+void Ftp::probeServers(std::vector<ServerInfo>& servers, long deadlineMs)
+{
+    if (servers.empty()) {
         return;
     }
 
-    // Open the file
-    HANDLE hFile = CreateFileA(filePath.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ,
-        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (hFile == INVALID_HANDLE_VALUE)
-    {
-        logError(L"Failed to open file for setting time: " + stringToWString(filePath), FTP_LOG_PATH);
+    CURLM* multi = curl_multi_init();
+    if (!multi) {
+        logError(L"[FTP] Failed to initialize CURL multi handle for probing", FTP_LOG_PATH);
         return;
     }
 
-    // We set only the file modification time
-    if (!SetFileTime(hFile, nullptr, nullptr, &fileTime))
-    {
-        logError(L"Failed to set file modification time: " + stringToWString(filePath), FTP_LOG_PATH);
+    // Recorders with an open breaker are skipped without any network traffic
+    std::map<std::string, bool> hostAllowed;
+    for (const auto& server : servers) {
+        std::string host = wstringToString(server.ip);
+        if (hostAllowed.find(host) == hostAllowed.end()) {
+            hostAllowed[host] = breaker.allowRequest(host);
+        }
     }
 
-    CloseHandle(hFile);
-}
+    // Rows of one directory differ only in the local part, such URLs are probed once
+    std::map<std::string, std::unique_ptr<FtpSession>> probes;
+    std::vector<FtpSession*> serverProbes(servers.size(), nullptr);
+    for (size_t i = 0; i < servers.size(); ++i) {
+        const ServerInfo& server = servers[i];
+        if (!hostAllowed[wstringToString(server.ip)]) {
+            continue;
+        }
 
-static size_t throw_away(void* ptr, size_t size, size_t nmemb, void* data)
-{
-    (void)ptr;
-    (void)data;
-    return (size_t)(size * nmemb);
-}
+        std::string userPwd = wstringToString(server.login) + ":" + wstringToString(server.pass);
+        std::string url = wstringToString(Ftp::protocol() + server.ip + L"/" + server.remoteFolderPath + L"/");
 
-// Downloading file from server
-bool Ftp::downloadFile(const std::string& fileName, const ServerInfo& server, const std::string url, const std::wstring& ftpCacheDirPath)
-{
-    // logFtpError("[FTP]: Starting file download for " + fileName + " from URL: " + url);
+        auto& probe = probes[url + "|" + userPwd];
+        if (!probe) {
+            probe = std::make_unique<FtpSession>(userPwd, 0L);
+            if (!probe->isValid()) {
+                continue;
+            }
+            probe->prepareProbe(url, deadlineMs);
+            curl_multi_add_handle(multi, probe->handle());
+        }
+        serverProbes[i] = probe.get();
+    }
 
-    CURL* curl;
-    FILE* file = nullptr;
-    CURLcode res;
-    long filetime = -1;
-    std::wstring dataFile;
+    std::map<CURL*, CURLcode> results;
+    int running = 0;
+    do {
+        curl_multi_perform(multi, &running);
 
-    curl = curl_easy_init();
-    if (curl) {
-        // Construct the file path and convert it to a wide string for _wfopen
-        dataFile = ftpCacheDirPath + L"/" + stringToWString(fileName);
-        // logFtpError("[FTP]: Constructed file path for download: " + dataFile);
-
-        // Set URL and credentials for the download
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_USERPWD, (wstringToString(server.login) + ":" + wstringToString(server.pass)).c_str());
-
-        // Try to open the file for writing with _wfopen
-        file = _wfopen(dataFile.c_str(), L"wb");
-        if (file == nullptr) {
-            logError(L"[FTP3]: Error opening file for writing: " + stringToWString(fileName), FTP_LOG_PATH);
-            logError(L"[FTP4]: Full file path: " + dataFile, FTP_LOG_PATH);
-            perror("fopen");  // Outputs error to stderr for debugging
-            curl_easy_cleanup(curl);
-            return false;
-        }
-        // logFtpError("[FTP]: File opened successfully for writing: " + dataFile);
-
-        // Set the write function and data handler for the download
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, file);
-
-        // Perform the file download
-        res = curl_easy_perform(curl);
-        if (res != CURLE_OK) {
-            logError(L"[FTP5]: Error during file download for " + stringToWString(fileName) + L": " + stringToWString(curl_easy_strerror(res)), FTP_LOG_PATH);
-            fclose(file);
-            curl_easy_cleanup(curl);
-            return false;
+        CURLMsg* msg = nullptr;
+        int msgsLeft = 0;
+        while ((msg = curl_multi_info_read(multi, &msgsLeft)) != nullptr) {
+            if (msg->msg == CURLMSG_DONE) {
+                results[msg->easy_handle] = msg->data.result;
+            }
         }
-        // Get file time 
-        curl_easy_setopt(curl, CURLOPT_FILETIME, 1L);
-        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, throw_away);
-        curl_easy_setopt(curl, CURLOPT_HEADER, 0L);
 
-        res = curl_easy_perform(curl);
-        fclose(file);
+        if (running > 0) {
+            curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+        }
+    } while (running > 0);
+
+    std::vector<ServerInfo> reachable;
+    std::map<std::string, bool> hostReachable;
+    for (size_t i = 0; i < servers.size(); ++i) {
+        ServerInfo& server = servers[i];
+        FtpSession* probe = serverProbes[i];
+        if (!probe) {
+            // Not polled in this cycle, the directory backs off as after an empty listing
+            scheduler.recordPoll(pollKey(server), 0, false);
+            continue;
+        }
 
-        if (CURLE_OK == res) {
-            res = curl_easy_getinfo(curl, CURLINFO_FILETIME, &filetime);
-            if ((CURLE_OK == res) && (filetime >= 0)) {
+        // A recorder is alive if any of its directories answered
+        bool& hostResult = hostReachable[wstringToString(server.ip)];
 
-                std::time_t rawTime = static_cast<std::time_t>(filetime);
-                std::tm* timeinfo = std::gmtime(&rawTime);
+        auto result = results.find(probe->handle());
+        if (result == results.end() || result->second != CURLE_OK) {
+            //logFtpError(L"[FTP] Connection failed for " + server.ip + L"/" + server.remoteFolderPath + L"/");
+            scheduler.recordPoll(pollKey(server), 0, false);
+            continue;
+        }
 
-                char buffer[40];    // Here contains time
-                std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", timeinfo);
+        hostResult = true;
 
-                std::string timestamp = std::string(buffer); 
-                setFileTime(wstringToString(dataFile), timestamp);
-            }
-        }
-        else {
-            logError(L"Failed to get file time!", FTP_LOG_PATH);
-            curl_easy_cleanup(curl);
+        curl_off_t connectTime = 0;
+        if (curl_easy_getinfo(probe->handle(), CURLINFO_CONNECT_TIME_T, &connectTime) == CURLE_OK) {
+            server.connectLatencyMs = static_cast<long>(connectTime / 1000);
         }
 
-        // logFtpError("[FTP]: File downloaded successfully: " + fileName);
+        auto now = std::chrono::system_clock::now();
+        server.lastPingTime = std::chrono::system_clock::to_time_t(now);
+        pingServer(server.reconId, server.lastPingTime);
+        logError(L"[FTP] Connection successful for " + server.ip + L"/" + server.remoteFolderPath + L"/ (" +
+            std::to_wstring(server.connectLatencyMs) + L" ms)", FTP_LOG_PATH);
 
-        // Cleanup after download
-        curl_easy_cleanup(curl);
-    }
-    else {
-        logError(L"[FTP6]: Failed to initialize CURL for downloading: " + stringToWString(fileName), FTP_LOG_PATH);
+        reachable.push_back(std::move(server));
     }
 
-    // The next rows might be for deleting 
-    json j = {
-        {"targetPath", wstringToUtf8(server.localFolderPath)}
-    };
-
-    std::string jsonInfo = j.dump(4);
-
-    std::ofstream metaFile(wstringToString(ftpCacheDirPath) + "/" + fileName + ".meta");
-
-    if (metaFile.is_open()) {
-        metaFile << jsonInfo;
-        metaFile.close();
+    for (auto& probe : probes) {
+        if (probe.second && probe.second->isValid()) {
+            curl_multi_remove_handle(multi, probe.second->handle());
+        }
     }
-    // If the file was open, close it before returning
-    if (file) {
-        fclose(file);
+    curl_multi_cleanup(multi);
+
+    for (const auto& host : hostReachable) {
+        if (host.second) {
+            breaker.recordSuccess(host.first);
+        }
+        else {
+            breaker.recordFailure(host.first);
+        }
     }
+    breaker.exportMetrics();
 
-    //logFtpError(L"[FTP]: Finished attempting to download file: " + stringToWString(fileName));
-    return true;
+    servers = std::move(reachable);
 }
 
-// Deleting a file from the server
-int Ftp::deleteFile(const std::string& filename, const ServerInfo& server, const std::string& url)
+void Ftp::setFileTime(const std::wstring& filePath, std::time_t modificationTime)
 {
-    CURL* curl;
-    CURLcode res;
-    std::string fullRemotePath = url;
-
-    curl = curl_easy_init();
-    if (!curl) {
-        logError(L"[FTP9]: Error generating CURL.", FTP_LOG_PATH);
-        return -1;
-    }
-
-    std::string deleCommand = "DELE " + filename;
-
-    curl_easy_setopt(curl, CURLOPT_URL, fullRemotePath.c_str());  
-    curl_easy_setopt(curl, CURLOPT_USERPWD, (wstringToString(server.login) + ":" + wstringToString(server.pass)).c_str());
-    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, deleCommand.c_str());
-    curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-
-    res = curl_easy_perform(curl);
-
-    long response_code;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-    if (response_code == 250) {
-        //logFtpError(stringToWString("[FTP]: File successfully deleted: ") + stringToWString(fullRemotePath + "/" + filename));
-        curl_easy_cleanup(curl);
-        return 1;    
-    }
-    else {
-        if (res != CURLE_FTP_COULDNT_RETR_FILE) {
-            logError(stringToWString("[FTP]: Error deleting file: ") + stringToWString(curl_easy_strerror(res)), FTP_LOG_PATH);
-            curl_easy_cleanup(curl);
-            return 1;
-        }
-        curl_easy_cleanup(curl);
-        return 1;
+    boost::system::error_code ec;
+    fs::last_write_time(fs::path(filePath), modificationTime, ec);
+    if (ec) {
+        logError(L"Failed to set file modification time: " + filePath + L": " + utf8_to_wstring(ec.message()), FTP_LOG_PATH);
     }
-
-    curl_easy_cleanup(curl);
-    return 0;
 }
 
 // Checking for a successful connection to the FTP server
 bool Ftp::checkConnection(const std::string& url, const std::string login, const std::string pass)
 {
-    CURL* curl;
-    CURLcode res;
-    bool connectionSuccessful = false;
-
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_USERPWD, (login + ":" + pass).c_str());
-        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "CWD");
-        curl_easy_setopt(curl, CURLOPT_PORT, 21);
-
-        res = curl_easy_perform(curl);
-
-        if (res == CURLE_OK) {
-            connectionSuccessful = true;
-        }
-        else {
-            //logFtpError(L"[FTP10]: Не удалось установить соединение " + stringToWString(url) + L": " + stringToWString(curl_easy_strerror(res)));
-            connectionSuccessful = false;
-        }
-
-        curl_easy_cleanup(curl);
-        return connectionSuccessful;
-    }
-    else {
+    FtpSession session(login + ":" + pass, 0L);
+    if (!session.isValid()) {
         logError(stringToWString("[FTP11]: Ошибка инициализации libcurl"), FTP_LOG_PATH);
         return false;
     }
+
+    session.prepareProbe(url, 0L);
+    CURLcode res = session.perform();
+
+    //if (res != CURLE_OK) logFtpError(L"[FTP10]: Не удалось установить соединение " + stringToWString(url) + L": " + stringToWString(curl_easy_strerror(res)));
+    return res == CURLE_OK;
 }
 
 bool Ftp::isServerActive(const ServerInfo& server, SQLHDBC dbc)
@@ -582,68 +613,3 @@ void Ftp::createLocalDirectoryTree(ServerInfo& server, std::string rootFolder) {
         fs::create_directories(fullPath);
     }
 }
-
-// Transferring files and deleting from the server
-void Ftp::fileTransfer(const ServerInfo& server, const std::string& url,
-    const std::wstring& oneDrivePath,
-    std::atomic_bool& ftpIsActive,
-    std::atomic_bool& oneDriveIsActive,
-    SQLHDBC dbc,
-    const std::wstring& ftpCacheDirPath)
-{
-    try {
-        // Initialize the context
-        FtpTransferContext context{
-            &server,
-            url,
-            oneDrivePath,
-            &ftpIsActive,
-            &oneDriveIsActive,
-            dbc,
-            ftpCacheDirPath
-        };
-
-        //logFtpError(L"[FTP] Starting file transfer for: " + stringToWString(url));
-
-        std::unique_ptr<CURL, decltype(&curl_easy_cleanup)> curl(curl_easy_init(), &curl_easy_cleanup);
-        if (!curl) {
-            logError(L"[FTP] Failed to initialize CURL", FTP_LOG_PATH);
-            return;
-        }
-
-        curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl.get(), CURLOPT_USERPWD,
-            (wstringToString(server.login) + ":" + wstringToString(server.pass)).c_str());
-        curl_easy_setopt(curl.get(), CURLOPT_DIRLISTONLY, 1L);
-        curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, write_list_stream);
-        curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &context);
-        curl_easy_setopt(curl.get(), CURLOPT_TIMEOUT, 10L);
-        curl_easy_setopt(curl.get(), CURLOPT_BUFFERSIZE, 32768); // 32KB буфер
-        curl_easy_setopt(curl.get(), CURLOPT_TCP_KEEPALIVE, 0L);
-
-        CURLcode res = curl_easy_perform(curl.get());
-        //logFtpError(L"[FTP] curl_easy_perform() result: " + stringToWString(curl_easy_strerror(res)));
-
-        if (res != CURLE_OK) {
-            std::string error = curl_easy_strerror(res);
-            logError(L"[FTP] Error: " + stringToWString(error), FTP_LOG_PATH);
-        }
-
-        //logFtpError(L"[FTP] File transfer completed.");
-    }
-    catch (const std::bad_alloc&) {
-        logError(L"[FTP] Memory allocation failed", EXCEPTION_LOG_PATH);
-    }
-    catch (const std::exception& e) {
-        logError(stringToWString("[FTP] Error: ") + stringToWString(e.what()), EXCEPTION_LOG_PATH);
-    }
-    catch (...) {
-        logError(L"[FTP] Unknown error occurred", EXCEPTION_LOG_PATH);
-    }
-}
-
-
-
-
-
-
@@ -0,0 +1,578 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING
+
+#include "ftp_harvester.h"
+#include "utils.h"
+#include "metrics.h"
+#include <nlohmann/json.hpp>
+#include <thread>
+
+using json = nlohmann::json;
+
+FtpEngineConfig parseFtpEngineConfig(const std::string& jsonString)
+{
+    FtpEngineConfig config;
+    if (jsonString.empty()) {
+        return config;
+    }
+
+    try {
+        json configJson = json::parse(jsonString);
+
+        // Only positive numbers override the defaults
+        auto safeSetLimit = [&](const char* key, auto& value) {
+            using T = std::decay_t<decltype(value)>;
+            if (configJson.contains(key) && configJson[key].is_number() && configJson[key].get<double>() > 0) {
+                value = configJson[key].get<T>();
+            }
+            };
+
+        safeSetLimit("maxConnections", config.maxConnections);
+        safeSetLimit("maxPerServer", config.maxPerServer);
+        safeSetLimit("connectTimeout", config.connectTimeout);
+        safeSetLimit("probeDeadlineMs", config.probeDeadlineMs);
+        safeSetLimit("breakerThreshold", config.breakerThreshold);
+        safeSetLimit("breakerBaseBackoff", config.breakerBaseBackoff);
+        safeSetLimit("breakerMaxBackoff", config.breakerMaxBackoff);
+        safeSetLimit("pollMinInterval", config.pollMinInterval);
+        safeSetLimit("pollMaxInterval", config.pollMaxInterval);
+        safeSetLimit("listTimeout", config.listTimeout);
+        safeSetLimit("transferTimeout", config.transferTimeout);
+        safeSetLimit("maxFilesPerSession", config.maxFilesPerSession);
+        safeSetLimit("handoffTimeout", config.handoffTimeout);
+        safeSetLimit("handoffMaxFileSize", config.handoffMaxFileSize);
+        safeSetLimit("partialRetention", config.partialRetention);
+
+        if (configJson.contains("directHandoff") && configJson["directHandoff"].is_boolean()) {
+            config.directHandoff = configJson["directHandoff"].get<bool>();
+        }
+    }
+    catch (const json::exception& e) {
+        logError(L"[FTP] Engine config parsing error, defaults are used: " + stringToWString(e.what()), EXCEPTION_LOG_PATH);
+    }
+
+    return config;
+}
+
+FtpHarvester::Transfer::~Transfer()
+{
+    if (file) {
+        fclose(file);
+    }
+}
+
+FtpHarvester::FtpHarvester(const FtpEngineConfig& config,
+    const std::wstring& oneDrivePath,
+    const std::wstring& ftpCacheDirPath,
+    std::atomic_bool& ftpIsActive,
+    std::atomic_bool& oneDriveIsActive,
+    HarvestedFileQueue* inbox,
+    const std::atomic_bool* inboxIsDrained)
+    : config(config),
+    oneDrivePath(oneDrivePath),
+    ftpCacheDirPath(ftpCacheDirPath),
+    ftpIsActive(ftpIsActive),
+    oneDriveIsActive(oneDriveIsActive),
+    inbox(inbox),
+    inboxIsDrained(inboxIsDrained)
+{
+    multi = curl_multi_init();
+    if (!multi) {
+        logError(L"[FTP] Failed to initialize CURL multi handle", FTP_LOG_PATH);
+        return;
+    }
+
+    // libcurl enforces the same caps on the connection pool
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, this->config.maxConnections);
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, this->config.maxPerServer);
+    // Idle control connections must survive between the commands of a session
+    curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, this->config.maxConnections);
+}
+
+FtpHarvester::~FtpHarvester()
+{
+    if (multi) {
+        curl_multi_cleanup(multi);
+    }
+}
+
+void FtpHarvester::run(const std::vector<ServerInfo>& servers)
+{
+    if (!multi) {
+        return;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+
+    jobs.clear();
+    sessionPools.clear();
+    activePerHost.clear();
+    activeTotal = 0;
+    pendingHandoffs.clear();
+
+    // Partial downloads whose remote file did not come back in time will never be resumed
+    Ftp::removeStalePartials(ftpCacheDirPath, std::chrono::seconds(config.partialRetention));
+
+    for (const auto& server : servers) {
+        auto job = std::make_unique<ServerJob>();
+        job->server = &server;
+        job->url = wstringToString(Ftp::getInstance().protocol()) + wstringToString(server.ip) + "/" +
+            Ftp::getInstance().encodeURL(wstringToString(server.remoteFolderPath)) + "/";
+        job->userPwd = wstringToString(server.login) + ":" + wstringToString(server.pass);
+        job->hostKey = wstringToString(server.ip);
+        job->pool = &sessionPools[job->hostKey + "|" + wstringToString(server.login)];
+        jobs.push_back(std::move(job));
+    }
+
+    while (true) {
+        checkHandoffs();
+
+        // After deactivation the running transfers are completed, new ones are not started
+        if (ftpIsActive.load(std::memory_order_acquire)) {
+            scheduleTransfers();
+        }
+        if (activeTotal == 0 && pendingHandoffs.empty()) {
+            break;
+        }
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        CURLMsg* msg = nullptr;
+        int msgsLeft = 0;
+        bool finishedAny = false;
+        while ((msg = curl_multi_info_read(multi, &msgsLeft)) != nullptr) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            Transfer* transfer = nullptr;
+            CURLcode result = msg->data.result;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &transfer);
+            if (transfer) {
+                finishTransfer(transfer, result);
+                finishedAny = true;
+            }
+        }
+
+        // A finished transfer frees its session and may have queued the next command, e.g. DELE after RETR
+        if (finishedAny) {
+            continue;
+        }
+
+        // Handed over files are checked often, their DELE should not wait for network activity
+        const int pollTimeoutMs = pendingHandoffs.empty() ? 1000 : 100;
+        if (activeTotal > 0) {
+            curl_multi_poll(multi, nullptr, 0, pollTimeoutMs, nullptr);
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(pollTimeoutMs));
+        }
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    size_t sessionsOpened = 0;
+    for (const auto& pool : sessionPools) {
+        sessionsOpened += pool.second.sessions.size();
+    }
+    logError(L"[FTP] Harvest pass over " + std::to_wstring(servers.size()) + L" directories finished in " +
+        std::to_wstring(elapsed.count()) + L" ms, FTP sessions opened: " + std::to_wstring(sessionsOpened), FTP_LOG_PATH);
+
+    // Arrivals of this pass set the next listing time of every directory, a failed listing backs off as an empty one
+    CircuitBreaker& breaker = Ftp::getInstance().circuitBreaker();
+    for (const auto& job : jobs) {
+        if (job->listSucceeded) {
+            Ftp::getInstance().pollScheduler().recordPoll(Ftp::pollKey(*job->server), job->queuedFiles,
+                job->queuedFiles >= config.maxFilesPerSession);
+        }
+        else if (job->listFinished) {
+            Ftp::getInstance().pollScheduler().recordPoll(Ftp::pollKey(*job->server), 0, false);
+            breaker.recordFailure(job->hostKey);
+        }
+    }
+    breaker.exportMetrics();
+
+    Metrics::getInstance().dump();
+
+    jobs.clear();
+    sessionPools.clear();
+}
+
+void FtpHarvester::scheduleTransfers()
+{
+    // Round robin: one new operation per server per sweep, so a big directory does not starve the others
+    bool startedAny = true;
+    while (startedAny && activeTotal < config.maxConnections) {
+        startedAny = false;
+
+        for (auto& jobPtr : jobs) {
+            ServerJob& job = *jobPtr;
+            if (activeTotal >= config.maxConnections) {
+                break;
+            }
+            if (activePerHost[job.hostKey] >= config.maxPerServer) {
+                continue;
+            }
+
+            if (!job.listStarted) {
+                startedAny |= startTransfer(job, Operation::List, std::string());
+            }
+            else if (!job.toDelete.empty()) {
+                std::string fileName = job.toDelete.front();
+                job.toDelete.pop_front();
+                startedAny |= startTransfer(job, Operation::Delete, fileName);
+            }
+            else if (!job.toRetrieve.empty()) {
+                std::string fileName = job.toRetrieve.front();
+                job.toRetrieve.pop_front();
+                startedAny |= startTransfer(job, Operation::Retrieve, fileName);
+            }
+        }
+    }
+}
+
+FtpSession* FtpHarvester::acquireSession(ServerJob& job)
+{
+    SessionPool& pool = *job.pool;
+    if (!pool.idle.empty()) {
+        FtpSession* session = pool.idle.back();
+        pool.idle.pop_back();
+        return session;
+    }
+
+    auto session = std::make_unique<FtpSession>(job.userPwd, config.connectTimeout);
+    if (!session->isValid()) {
+        return nullptr;
+    }
+    pool.sessions.push_back(std::move(session));
+    return pool.sessions.back().get();
+}
+
+bool FtpHarvester::startTransfer(ServerJob& job, Operation operation, const std::string& fileName)
+{
+    if (operation == Operation::List) {
+        job.listStarted = true;
+    }
+
+    auto transfer = std::make_unique<Transfer>();
+    transfer->harvester = this;
+    transfer->operation = operation;
+    transfer->job = &job;
+    transfer->fileName = fileName;
+    transfer->session = acquireSession(job);
+    if (!transfer->session) {
+        logError(L"[FTP] Failed to open FTP session for " + stringToWString(job.url), FTP_LOG_PATH);
+        if (operation == Operation::List) {
+            job.listFinished = true;
+        }
+        return false;
+    }
+
+    FtpSession& session = *transfer->session;
+    switch (operation) {
+    case Operation::List:
+        session.prepareList(job.url, onListData, transfer.get(), config.listTimeout);
+        break;
+
+    case Operation::Retrieve:
+        // Data goes into a ".part" file, it is renamed once complete
+        transfer->localPath = Ftp::partialPath(fileName, ftpCacheDirPath);
+        transfer->resumeFrom = static_cast<curl_off_t>(Ftp::partialSize(transfer->localPath));
+        if (transfer->resumeFrom == 0 && handoffAvailable()) {
+            // Kept in memory for integration, the ".part" file is only used if the handoff is not possible
+            transfer->inMemory = true;
+            session.prepareRetrieve(job.url + fileName, onRetrieveData, transfer.get(), config.transferTimeout);
+            break;
+        }
+        // An interrupted earlier download is continued from its last byte
+        transfer->file = _wfopen(transfer->localPath.c_str(), transfer->resumeFrom > 0 ? L"ab" : L"wb");
+        if (!transfer->file) {
+            logError(L"[FTP] Error opening file for writing: " + transfer->localPath, FTP_LOG_PATH);
+            job.pool->idle.push_back(transfer->session);
+            return false;
+        }
+        session.prepareRetrieve(job.url + fileName, transfer->file, config.transferTimeout, transfer->resumeFrom);
+        if (transfer->resumeFrom > 0) {
+            Metrics::getInstance().add("ftp.downloads_resumed");
+        }
+        break;
+
+    case Operation::Delete:
+        session.prepareDelete(job.url, fileName, config.transferTimeout);
+        break;
+    }
+    curl_easy_setopt(session.handle(), CURLOPT_PRIVATE, transfer.get());
+
+    if (curl_multi_add_handle(multi, session.handle()) != CURLM_OK) {
+        logError(L"[FTP] Failed to add transfer to CURL multi handle: " + stringToWString(job.url + fileName), FTP_LOG_PATH);
+        job.pool->idle.push_back(transfer->session);
+        if (operation == Operation::List) {
+            job.listFinished = true;
+        }
+        return false;
+    }
+
+    ++job.active;
+    ++activePerHost[job.hostKey];
+    ++activeTotal;
+    transfer.release();
+    return true;
+}
+
+void FtpHarvester::finishTransfer(Transfer* transfer, CURLcode result)
+{
+    std::unique_ptr<Transfer> owner(transfer);
+    ServerJob& job = *transfer->job;
+
+    curl_multi_remove_handle(multi, transfer->session->handle());
+    --job.active;
+    --activePerHost[job.hostKey];
+    --activeTotal;
+
+    try {
+        switch (transfer->operation) {
+        case Operation::List:
+            onListFinished(job, *transfer, result);
+            break;
+        case Operation::Retrieve:
+            onRetrieveFinished(job, *transfer, result);
+            break;
+        case Operation::Delete:
+            onDeleteFinished(job, *transfer, result);
+            break;
+        }
+    }
+    catch (const fs::filesystem_error& e) {
+        logError(L"[FTP] Filesystem error processing " + stringToWString(transfer->fileName) + L": " +
+            utf8_to_wstring(e.what()), EXCEPTION_LOG_PATH);
+    }
+    catch (const std::exception& e) {
+        logError(L"[FTP] Error processing " + stringToWString(transfer->fileName) + L": " +
+            stringToWString(e.what()), EXCEPTION_LOG_PATH);
+    }
+
+    // The connection stays open for the next command of this recorder
+    job.pool->idle.push_back(transfer->session);
+}
+
+size_t FtpHarvester::onListData(void* buffer, size_t size, size_t nmemb, void* userp)
+{
+    Transfer* transfer = static_cast<Transfer*>(userp);
+    FtpHarvester* harvester = transfer->harvester;
+    ServerJob& job = *transfer->job;
+    const size_t totalSize = size * nmemb;
+
+    transfer->lines.feed(static_cast<const char*>(buffer), totalSize, [harvester, &job](const std::string& fileName) {
+        harvester->queueListedFile(job, fileName);
+        });
+    return totalSize;
+}
+
+void FtpHarvester::queueListedFile(ServerJob& job, const std::string& fileName)
+{
+    if (job.queuedFiles >= config.maxFilesPerSession || !startsWithValidPrefix(fileName)) {
+        return;
+    }
+    job.toRetrieve.push_back(fileName);
+    ++job.queuedFiles;
+}
+
+void FtpHarvester::onListFinished(ServerJob& job, Transfer& transfer, CURLcode result)
+{
+    job.listFinished = true;
+
+    // Entries received before an error are real files and stay queued
+    transfer.lines.finish([this, &job](const std::string& fileName) {
+        queueListedFile(job, fileName);
+        });
+
+    if (result != CURLE_OK) {
+        logError(L"[FTP] Listing error for " + stringToWString(job.url) + L": " +
+            stringToWString(curl_easy_strerror(result)), FTP_LOG_PATH);
+        return;
+    }
+    job.listSucceeded = true;
+}
+
+size_t FtpHarvester::onRetrieveData(void* buffer, size_t size, size_t nmemb, void* userp)
+{
+    Transfer* transfer = static_cast<Transfer*>(userp);
+    const size_t totalSize = size * nmemb;
+
+    if (transfer->inMemory) {
+        if (transfer->buffer.size() + totalSize <= transfer->harvester->config.handoffMaxFileSize) {
+            transfer->buffer.append(static_cast<const char*>(buffer), totalSize);
+            Metrics::getInstance().add("ftp.bytes_downloaded", totalSize);
+            return totalSize;
+        }
+
+        // Too big to be held in memory, the rest of the download goes to disk
+        transfer->file = _wfopen(transfer->localPath.c_str(), L"wb");
+        if (!transfer->file) {
+            logError(L"[FTP] Error opening file for writing: " + transfer->localPath, FTP_LOG_PATH);
+            return 0;
+        }
+        if (fwrite(transfer->buffer.data(), 1, transfer->buffer.size(), transfer->file) != transfer->buffer.size()) {
+            return 0;
+        }
+        std::string().swap(transfer->buffer);
+        transfer->inMemory = false;
+    }
+
+    return Ftp::write_data(buffer, size, nmemb, transfer->file);
+}
+
+void FtpHarvester::onRetrieveFinished(ServerJob& job, Transfer& transfer, CURLcode result)
+{
+    if (transfer.file) {
+        fclose(transfer.file);
+        transfer.file = nullptr;
+    }
+
+    if (result != CURLE_OK) {
+        logError(L"[FTP] Error during file download for " + stringToWString(transfer.fileName) + L": " +
+            stringToWString(curl_easy_strerror(result)), FTP_LOG_PATH);
+        // A truncated file must not reach the integration module, it waits as ".part" for the next attempt
+        if (transfer.inMemory && !transfer.buffer.empty()) {
+            Ftp::writeBufferToFile(transfer.localPath, transfer.buffer);
+        }
+        Ftp::keepPartial(transfer.localPath, result);
+        return;
+    }
+
+    // The remote file is deleted only when the local copy is complete
+    if (transfer.inMemory) {
+        curl_off_t expected = transfer.session->expectedSize();
+        if (expected >= 0 && static_cast<curl_off_t>(transfer.buffer.size()) != expected) {
+            logError(L"[FTP] Downloaded size of " + stringToWString(transfer.fileName) + L" differs from the remote size, discarding", FTP_LOG_PATH);
+            return;
+        }
+    }
+    else if (!Ftp::verifyDownloadSize(transfer.localPath, *transfer.session)) {
+        return;
+    }
+
+    Metrics::getInstance().add("ftp.files_downloaded");
+
+    long filetime = transfer.session->fileTime();
+    if (transfer.inMemory) {
+        if (handOff(job, transfer, filetime)) {
+            return;
+        }
+
+        // Integration is busy, the file takes the usual way through Cache
+        Metrics::getInstance().add("ftp.handoff_fallback");
+        if (!Ftp::writeBufferToFile(transfer.localPath, transfer.buffer)) {
+            boost::system::error_code ec;
+            fs::remove(transfer.localPath, ec);
+            return;
+        }
+    }
+
+    publishToCache(job, transfer.fileName, transfer.localPath, filetime);
+}
+
+bool FtpHarvester::handoffAvailable() const
+{
+    return inbox && (!inboxIsDrained || inboxIsDrained->load(std::memory_order_acquire));
+}
+
+bool FtpHarvester::handOff(ServerJob& job, Transfer& transfer, long filetime)
+{
+    if (!handoffAvailable()) {
+        return false;
+    }
+
+    auto file = std::make_shared<HarvestedFile>();
+    file->fileName = transfer.fileName;
+    file->server = *job.server;
+    file->data = std::move(transfer.buffer);
+    file->modificationTime = filetime >= 0 ? static_cast<std::time_t>(filetime) : -1;
+    if (oneDriveIsActive.load(std::memory_order_acquire)) {
+        file->oneDrivePath = oneDrivePath;
+    }
+
+    PendingHandoff pending;
+    pending.job = &job;
+    pending.fileName = transfer.fileName;
+    pending.file = file;
+    pending.persisted = file->persisted.get_future();
+    pending.deadline = std::chrono::steady_clock::now() + std::chrono::seconds(config.handoffTimeout);
+
+    if (!inbox->tryPush(file)) {
+        transfer.buffer = std::move(file->data);
+        return false;
+    }
+
+    Metrics::getInstance().add("ftp.handoff_direct");
+    pendingHandoffs.push_back(std::move(pending));
+    return true;
+}
+
+void FtpHarvester::checkHandoffs()
+{
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = pendingHandoffs.begin(); it != pendingHandoffs.end();) {
+        if (it->persisted.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            bool persisted = false;
+            try {
+                persisted = it->persisted.get();
+            }
+            catch (const std::exception& e) {
+                logError(L"[FTP] Handoff of " + stringToWString(it->fileName) + L" failed: " + stringToWString(e.what()), FTP_LOG_PATH);
+            }
+
+            if (persisted) {
+                it->job->toDelete.push_back(it->fileName);
+            }
+            else {
+                logError(L"[FTP] Integration could not store " + stringToWString(it->fileName) + L", it stays on the recorder", FTP_LOG_PATH);
+            }
+            it = pendingHandoffs.erase(it);
+        }
+        // A file integration has already taken is waited for, its promise is always fulfilled.
+        // Once integration stops draining the inbox nothing queued is taken before the next Cache sweep
+        else if ((now >= it->deadline || !handoffAvailable()) && it->file->withdraw()) {
+            // Integration skips the queued copy, the download takes the usual way through Cache
+            logError(L"[FTP] Handoff of " + stringToWString(it->fileName) + L" was not taken in time, storing it in Cache", FTP_LOG_PATH);
+            Metrics::getInstance().add("ftp.handoff_withdrawn");
+            std::wstring localPath = Ftp::partialPath(it->fileName, ftpCacheDirPath);
+            if (Ftp::writeBufferToFile(localPath, it->file->data)) {
+                publishToCache(*it->job, it->fileName, localPath, static_cast<long>(it->file->modificationTime));
+            }
+            else {
+                boost::system::error_code ec;
+                fs::remove(localPath, ec);
+            }
+            std::string().swap(it->file->data);
+            it = pendingHandoffs.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void FtpHarvester::publishToCache(ServerJob& job, const std::string& fileName, const std::wstring& localPath, long filetime)
+{
+    if (filetime >= 0) {
+        Ftp::getInstance().setFileTime(localPath, static_cast<std::time_t>(filetime));
+    }
+
+    // The copy is taken while the file is still private to the FTP module
+    if (oneDriveIsActive.load(std::memory_order_acquire)) {
+        Ftp::getInstance().copyToOneDrive(fileName, *job.server, oneDrivePath, localPath);
+    }
+
+    // The file is deleted from the recorder only once it is visible in Cache
+    if (Ftp::getInstance().publishDownload(fileName, *job.server, ftpCacheDirPath)) {
+        job.toDelete.push_back(fileName);
+    }
+}
+
+void FtpHarvester::onDeleteFinished(ServerJob& job, Transfer& transfer, CURLcode result)
+{
+    if (result != CURLE_OK) {
+        logError(L"[FTP] Error deleting file " + stringToWString(transfer.fileName) + L": " +
+            stringToWString(curl_easy_strerror(result)), FTP_LOG_PATH);
+    }
+}
@@ -0,0 +1,129 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING
+
+#include "ftp_session.h"
+#include "ftp_handler.h"
+#include "utils.h"
+
+FtpSession::FtpSession(const std::string& userPwd, long connectTimeout)
+    : userPwd(userPwd),
+    connectTimeout(connectTimeout)
+{
+    curl = curl_easy_init();
+    if (!curl) {
+        logError(L"[FTP] Failed to initialize CURL for FTP session", FTP_LOG_PATH);
+    }
+}
+
+FtpSession::~FtpSession()
+{
+    if (curl) {
+        // Sends QUIT and closes the control connection
+        curl_easy_cleanup(curl);
+    }
+    if (quote) {
+        curl_slist_free_all(quote);
+    }
+}
+
+void FtpSession::reset(long timeout)
+{
+    if (quote) {
+        curl_slist_free_all(quote);
+        quote = nullptr;
+    }
+    resumeFrom = 0;
+    if (!curl) {
+        return;
+    }
+
+    // curl_easy_reset keeps live connections, so the login is not repeated
+    curl_easy_reset(curl);
+
+    curl_easy_setopt(curl, CURLOPT_USERPWD, userPwd.c_str());
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, connectTimeout);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
+}
+
+void FtpSession::prepareList(const std::string& dirUrl, WriteCallback onData, void* userp, long timeout)
+{
+    reset(timeout);
+    curl_easy_setopt(curl, CURLOPT_URL, dirUrl.c_str());
+    curl_easy_setopt(curl, CURLOPT_DIRLISTONLY, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, onData);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, userp);
+}
+
+void FtpSession::prepareRetrieve(const std::string& fileUrl, FILE* file, long timeout, curl_off_t resumeFrom)
+{
+    reset(timeout);
+    curl_easy_setopt(curl, CURLOPT_URL, fileUrl.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, Ftp::write_data);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, file);
+    // MDTM is sent on the same control connection before RETR
+    curl_easy_setopt(curl, CURLOPT_FILETIME, 1L);
+    if (resumeFrom > 0) {
+        // SIZE is checked against the offset, then REST moves the server to it
+        curl_easy_setopt(curl, CURLOPT_RESUME_FROM_LARGE, resumeFrom);
+        this->resumeFrom = resumeFrom;
+    }
+}
+
+void FtpSession::prepareRetrieve(const std::string& fileUrl, WriteCallback onData, void* userp, long timeout)
+{
+    reset(timeout);
+    curl_easy_setopt(curl, CURLOPT_URL, fileUrl.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, onData);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, userp);
+    curl_easy_setopt(curl, CURLOPT_FILETIME, 1L);
+}
+
+void FtpSession::prepareDelete(const std::string& dirUrl, const std::string& fileName, long timeout)
+{
+    reset(timeout);
+    quote = curl_slist_append(nullptr, ("DELE " + fileName).c_str());
+    curl_easy_setopt(curl, CURLOPT_URL, dirUrl.c_str());
+    // After the CWD into the directory, a reused connection may still be in another directory
+    curl_easy_setopt(curl, CURLOPT_POSTQUOTE, quote);
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+}
+
+void FtpSession::prepareProbe(const std::string& dirUrl, long timeoutMs)
+{
+    // Login and CWD into the directory without any data transfer
+    reset(0L);
+    curl_easy_setopt(curl, CURLOPT_URL, dirUrl.c_str());
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    if (timeoutMs > 0) {
+        // The whole probe, connect included, must fit into the deadline
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, timeoutMs);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeoutMs);
+    }
+}
+
+CURLcode FtpSession::perform()
+{
+    if (!curl) {
+        return CURLE_FAILED_INIT;
+    }
+    return curl_easy_perform(curl);
+}
+
+long FtpSession::fileTime() const
+{
+    long filetime = -1;
+    if (!curl || curl_easy_getinfo(curl, CURLINFO_FILETIME, &filetime) != CURLE_OK) {
+        return -1;
+    }
+    return filetime;
+}
+
+curl_off_t FtpSession::expectedSize() const
+{
+    // libcurl reports the bytes left after the resume offset
+    curl_off_t length = -1;
+    if (!curl || curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length) != CURLE_OK || length < 0) {
+        return -1;
+    }
+    return resumeFrom + length;
+}
@@ -0,0 +1,53 @@
+#include "id_allocator.h"
+#include "statement_cache.h"
+#include "utils.h"
+
+IdAllocator::IdAllocator(const std::wstring& sequence, const std::wstring& table, int blockSize)
+    : sequence(sequence), table(table), blockSize(blockSize > 0 ? blockSize : 1)
+{
+}
+
+bool IdAllocator::allocate(SQLHDBC dbc, size_t count, std::vector<int>& ids)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ids.clear();
+    ids.reserve(count);
+    while (ids.size() < count) {
+        if (next >= end && !reserveBlock(dbc)) {
+            ids.clear();
+            return false;
+        }
+        ids.push_back(static_cast<int>(next++));
+    }
+    return true;
+}
+
+void IdAllocator::discard()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    next = end = 0;
+}
+
+bool IdAllocator::reserveBlock(SQLHDBC dbc)
+{
+    // Blocks the identity has already reached are skipped, rows inserted without the allocator must not collide
+    std::wstring query = L"SET NOCOUNT ON;"
+        L" DECLARE @hi BIGINT = NEXT VALUE FOR [" + sequence + L"];"
+        L" DECLARE @used BIGINT = ISNULL(IDENT_CURRENT(N'" + table + L"'), 0);"
+        L" WHILE @hi * ? <= @used SET @hi = NEXT VALUE FOR [" + sequence + L"];"
+        L" SELECT CAST(@hi AS INT);";
+
+    StatementLease stmt = StatementCache::forConnection(dbc).acquire(query);
+    if (!stmt || !SQL_SUCCEEDED(stmt->execute(blockSize))) {
+        logError(L"[Integration] Failed to reserve a block of ids from " + sequence, INTEGRATION_LOG_PATH);
+        return false;
+    }
+
+    int hi = 0;
+    if (!stmt->fetch() || !stmt->get(1, hi)) {
+        return false;
+    }
+    next = static_cast<long long>(hi) * blockSize;
+    end = next + blockSize;
+    return true;
+}
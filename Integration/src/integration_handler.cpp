@@ -10,10 +10,63 @@
 #include <db_connection.h>
 #include "utils.h"
 #include "mail_handler.h"
+#include "statement_cache.h"
+#include "reference_cache.h"
+#include "id_allocator.h"
+#include "metrics.h"
+#include "file_view.h"
+#include "file_name.h"
 
 namespace fs = boost::filesystem;
 
-std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
+// Converters keep state, every integration worker has its own
+thread_local std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
+
+// Ids of batched data rows, known before the insert so their data_process rows go in the same batch
+static IdAllocator dataIds(L"data_id_hi", L"data", DATA_ID_BLOCK_SIZE);
+
+// Cleared if the server refuses IDENTITY_INSERT, every data row is then numbered by the identity
+static std::atomic_bool explicitDataIds{ true };
+
+// Id of a new data row, -1 while the rows are numbered by the identity. Once the allocator is in use
+// every insert takes its id from it, a generated one would fall into a block another worker holds
+static bool takeDataId(SQLHDBC dbc, int& id) {
+    id = -1;
+    if (!explicitDataIds) {
+        return true;
+    }
+    std::vector<int> ids;
+    if (!dataIds.allocate(dbc, 1, ids)) {
+        return false;
+    }
+    id = ids.front();
+    return true;
+}
+
+// Switching IDENTITY_INSERT of the data table for the connection. Only a refusal of the server
+// turns the allocator off, a lost connection must not let the identity number rows again
+static bool setDataIdentityInsert(SQLHDBC dbc, bool on) {
+    SQLHSTMT hstmt = SQL_NULL_HSTMT;
+    if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, dbc, &hstmt))) {
+        return false;
+    }
+    const wchar_t* sql = on ? L"SET IDENTITY_INSERT [data] ON;" : L"SET IDENTITY_INSERT [data] OFF;";
+    SQLRETURN ret = SQLExecDirectW(hstmt, (SQLWCHAR*)sql, SQL_NTS);
+    if (!SQL_SUCCEEDED(ret)) {
+        SQLWCHAR sqlState[6] = {}, messageText[SQL_MAX_MESSAGE_LENGTH] = {};
+        SQLINTEGER nativeError = 0;
+        SQLSMALLINT textLength;
+        SQLGetDiagRecW(SQL_HANDLE_STMT, hstmt, 1, sqlState, &nativeError, messageText, SQL_MAX_MESSAGE_LENGTH, &textLength);
+        if (on && nativeError == 1088 && explicitDataIds.exchange(false)) { // No permission to alter the table
+            logError(L"[Integration] IDENTITY_INSERT is not allowed on data, data ids are generated by the server", INTEGRATION_LOG_PATH);
+        }
+        else {
+            logError(L"[Integration] Failed to switch IDENTITY_INSERT of data: " + std::wstring(messageText), INTEGRATION_LOG_PATH);
+        }
+    }
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    return SQL_SUCCEEDED(ret);
+}
 
 // Method of starting an external program with a flag and waiting for it to complete
 bool Integration::runExternalProgramWithFlag(const std::wstring& programPath, const std::wstring& inputFilePath) {
@@ -52,39 +105,6 @@ bool Integration::runExternalProgramWithFlag(const std::wstring& programPath, co
     }
 }
 
-bool Integration::isFileNameValid(const std::wstring& fileName) {
-    static const std::vector<std::wstring> validPrefixes = {
-        L"RNET", L"RPUSK", L"DAILY", L"DIAGN", L"RECON", L"REXPR"
-    };
-
-    return std::any_of(validPrefixes.begin(), validPrefixes.end(),
-        [&](const std::wstring& prefix) {
-            return boost::algorithm::istarts_with(fileName, prefix);
-        });
-}
-
-//Method to check if a file is a data file
-bool Integration::checkIsDataFile(const std::wstring& filePrefix) {
-    return filePrefix.size() >= 5 && (filePrefix == L"RECON" || filePrefix == L"recon");
-}
-
-// Method to check if a file is an express file
-bool Integration::checkIsExpressFile(const std::wstring& filePrefix) {
-    return filePrefix.size() >= 5 && (filePrefix == L"REXPR" || filePrefix == L"rexpr");
-}
-
-bool Integration::checkIsOtherFiles(const std::wstring& fileName)
-{
-    std::vector<std::wstring> validPrefixes = {
-        L"RNET", L"RPUSK", L"DAILY", L"DIAGN"
-    };
-
-    return std::any_of(validPrefixes.begin(), validPrefixes.end(),
-        [&](const std::wstring& prefix) {
-            return fileName.rfind(prefix, 0) == 0;
-        });
-}
-
 // Method to check if a folder is sorted
 bool Integration::isSortedFolder(const std::wstring& folderName) {
     try {
@@ -105,81 +125,21 @@ bool Integration::isSortedFolder(const std::wstring& folderName) {
     return false;
 }
 
-// Function to extract value from parameter string
-std::wstring Integration::extractParamValue(const std::wstring& content, const std::wstring& marker) {
-    std::size_t pos = content.rfind(marker);
-
-    if (pos != std::wstring::npos) {
-        std::size_t startPos = pos + marker.length();
-        std::size_t endPos = content.find(L'$', startPos);
-
-        if (endPos != std::wstring::npos) {
-            return content.substr(startPos, endPos - startPos);
-        }
-        else {
-            return content.substr(startPos);
-        }
-    }
-    return L"";
-}
-
-// Function to extract value using regular expression
-std::wstring Integration::extractValueWithRegex(const std::wstring& content, const std::wregex& regex) {
-    std::wsmatch match;
-    if (std::regex_search(content, match, regex) && match.size() > 1) {
-        return match.str(1);
-    }
-    return L"";
-}
-
-// Collecting file paths
-void Integration::collectRootPaths(std::unordered_set<std::wstring>& parentFolders, const std::wstring rootFolder) {
-    try {
-        std::wstring fullPath;
-        std::wstring currentDir;
-
-        if (!fs::exists(rootFolder) || !fs::is_directory(rootFolder)) {
-            logError(stringToWString("The folder does not exist or is inaccessible: ") + stringToWString(converter.to_bytes(rootFolder)), INTEGRATION_LOG_PATH);
-            return;
-        }
-
-        for (auto it = fs::recursive_directory_iterator(rootFolder); it != fs::recursive_directory_iterator(); ++it) {
-            if (fs::is_directory(*it)) {
-                fullPath = it->path().wstring();
-                if (fullPath != currentDir) {
-                    currentDir = fullPath;
-                }
-            }
-            else {
-                std::wstring fileName = it->path().filename().wstring(); 
-                std::size_t pos = it->path().wstring().find(fileName);      
-
-                std::wstring path = it->path().parent_path().wstring();
-
-                // Add a check to ignore the "Cache" folder
-                if (path.find(L"\\Cache") != std::wstring::npos || path.find(L"/Cache") != std::wstring::npos) {
-                    continue;
-                }
-                if (parentFolders.find(path) == parentFolders.end()) { 
-                    parentFolders.insert(path);
-                }
-            }
-        }
-    }
-    catch (const std::exception& e) {
-        logError(stringToWString("Exception caught in collectRootPaths: ") + stringToWString(e.what()), EXCEPTION_LOG_PATH);
-    }
-}
-
 void Integration::getRecordInfo(SQLHDBC dbc, std::shared_ptr<BaseFile> file, RecordsInfoFromDB& recordsInfo) {
 
-    SQLHSTMT hstmt = SQL_NULL_HSTMT;
-    SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, dbc, &hstmt);
-    if (!SQL_SUCCEEDED(ret)) {
-        logError(L"Failed to allocate SQL statement handle", INTEGRATION_LOG_PATH);
+    // Known unit and struct: only the data row is looked up
+    ReferenceCache& references = ReferenceCache::getInstance();
+    int cachedUnitId = references.unitId(file->unit, file->substation);
+    int cachedStructId = references.structId(file->reconNumber, file->object);
+    if (cachedUnitId != -1 && cachedStructId != -1) {
+        recordsInfo.unit_id = cachedUnitId;
+        recordsInfo.struct_id = cachedStructId;
+        getDataRecordInfo(dbc, file, recordsInfo);
         return;
     }
 
+    const bool isReconPair = file->filePrefix == L"RECON" || file->filePrefix == L"REXPR";
+
     std::wstring sqlQuery = LR"(
         SELECT 
             u.id AS unit_id,
@@ -205,11 +165,12 @@ void Integration::getRecordInfo(SQLHDBC dbc, std::shared_ptr<BaseFile> file, Rec
         LEFT JOIN [data] d 
             ON d.struct_id = s.id AND d.file_num = ?)";
 
-    if (file->filePrefix == L"RECON" || file->filePrefix == L"REXPR") {
+    // The file type is a parameter too, so there are only four query texts to prepare
+    if (isReconPair) {
         sqlQuery += LR"( AND d.date = CAST(? AS DATE) )";
     }
     else {
-        sqlQuery += L" AND d.time = CAST(? AS TIME(3)) AND d.file_type = '" + file->filePrefix + L"'";
+        sqlQuery += LR"( AND d.time = CAST(? AS TIME(3)) AND d.file_type = ? )";
     }
 
     if (recordsInfo.needDataProcess) {
@@ -222,52 +183,30 @@ void Integration::getRecordInfo(SQLHDBC dbc, std::shared_ptr<BaseFile> file, Rec
         WHERE u.unit = ? AND u.substation = ?
     )";
 
-    ret = SQLPrepareW(hstmt, (SQLWCHAR*)sqlQuery.c_str(), SQL_NTS);
-    if (!SQL_SUCCEEDED(ret)) {
-        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    StatementLease stmt = StatementCache::forConnection(dbc).acquire(sqlQuery);
+    if (!stmt) {
         return;
     }
 
-    std::wstring formattedDate = file->date.substr(6, 4) + L"-" + file->date.substr(3, 2) + L"-" + file->date.substr(0, 2);
-	int paramIndex = 1;
-
-    // Bind parameters
-    ret = SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 255, 0,
-        const_cast<int*>(&file->reconNumber), 0, nullptr);   
-
-    ret = SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,
-        (SQLWCHAR*)file->object.c_str(), 0, nullptr);
-
-    ret = SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_VARCHAR, 3, 0,
-        (SQLWCHAR*)file->fileNum.c_str(), 0, nullptr);
-
-    if (file->filePrefix == L"RECON" || file->filePrefix == L"REXPR") {
-        ret = SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, formattedDate.size(), 0,
-            (SQLWCHAR*)formattedDate.c_str(), (formattedDate.size() + 1) * sizeof(wchar_t), nullptr);
+    SQLRETURN ret;
+    if (isReconPair) {
+        std::wstring formattedDate = file->date.substr(6, 4) + L"-" + file->date.substr(3, 2) + L"-" + file->date.substr(0, 2);
+        ret = stmt->execute(file->reconNumber, file->object, file->fileNum, formattedDate, file->unit, file->substation);
     }
     else {
-        ret = SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 30, 0,
-            (SQLWCHAR*)file->time.c_str(), 0, nullptr);
+        ret = stmt->execute(file->reconNumber, file->object, file->fileNum, file->time, file->filePrefix, file->unit, file->substation);
     }
-
-    ret = SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,
-        (SQLWCHAR*)file->unit.c_str(), 0, nullptr);
-
-    ret = SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,
-        (SQLWCHAR*)file->substation.c_str(), 0, nullptr);
-
-    ret = SQLExecute(hstmt);
     if (!SQL_SUCCEEDED(ret)) {
-        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
         return;
     }
 
-    ret = SQLFetch(hstmt);
-    if (ret == SQL_SUCCESS) {
-        SQLGetData(hstmt, 1, SQL_C_SLONG, &recordsInfo.unit_id, 0, nullptr);
-        SQLGetData(hstmt, 2, SQL_C_SLONG, &recordsInfo.struct_id, 0, nullptr);
-        SQLGetData(hstmt, 3, SQL_C_SLONG, &recordsInfo.data_id, 0, nullptr);
-        SQLGetData(hstmt, 4, SQL_C_SLONG, &recordsInfo.dataProcess_id, 0, nullptr);
+    if (stmt->fetch()) {
+        stmt->get(1, recordsInfo.unit_id);
+        stmt->get(2, recordsInfo.struct_id);
+        stmt->get(3, recordsInfo.data_id);
+        stmt->get(4, recordsInfo.dataProcess_id);
+
+        SQLHSTMT hstmt = stmt->handle();
 
         // Temporary buffer
         char dummyBuffer[1];
@@ -286,10 +225,74 @@ void Integration::getRecordInfo(SQLHDBC dbc, std::shared_ptr<BaseFile> file, Rec
         // Reading the presence of d.other_type_file
         ret = SQLGetData(hstmt, 7, SQL_C_BINARY, dummyBuffer, sizeof(dummyBuffer), &otherFileLen);
         recordsInfo.hasOtherBinary = (otherFileLen != SQL_NULL_DATA && otherFileLen > 0);
+
+        // Ids created by someone else are remembered as well
+        if (recordsInfo.unit_id != -1) {
+            references.addUnit(file->unit, file->substation, recordsInfo.unit_id);
+        }
+        if (recordsInfo.struct_id != -1) {
+            references.addStruct(file->reconNumber, file->object, recordsInfo.struct_id);
+        }
     }
+}
 
-    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
-    return;
+void Integration::getDataRecordInfo(SQLHDBC dbc, std::shared_ptr<BaseFile> file, RecordsInfoFromDB& recordsInfo) {
+
+    const bool isReconPair = file->filePrefix == L"RECON" || file->filePrefix == L"REXPR";
+
+    std::wstring sqlQuery = LR"(
+        SELECT 
+            d.id AS data_id,)";
+
+    sqlQuery += recordsInfo.needDataProcess ? L" dp.id AS dataProcess_id," : L" NULL AS dataProcess_id,";
+
+    // Only the presence of the files is needed, their contents stay on the server
+    sqlQuery += LR"(
+            CASE WHEN DATALENGTH(d.data_file) > 0 THEN 1 ELSE 0 END,
+            CASE WHEN DATALENGTH(d.express_file) > 0 THEN 1 ELSE 0 END,
+            CASE WHEN DATALENGTH(d.other_type_file) > 0 THEN 1 ELSE 0 END
+        FROM [data] d)";
+
+    if (recordsInfo.needDataProcess) {
+        sqlQuery += L" LEFT JOIN [data_process] dp ON dp.id = d.id";
+    }
+
+    sqlQuery += L" WHERE d.struct_id = ? AND d.file_num = ?";
+    if (isReconPair) {
+        sqlQuery += L" AND d.date = CAST(? AS DATE)";
+    }
+    else {
+        sqlQuery += L" AND d.time = CAST(? AS TIME(3)) AND d.file_type = ?";
+    }
+
+    StatementLease stmt = StatementCache::forConnection(dbc).acquire(sqlQuery);
+    if (!stmt) {
+        return;
+    }
+
+    SQLRETURN ret;
+    if (isReconPair) {
+        std::wstring formattedDate = file->date.substr(6, 4) + L"-" + file->date.substr(3, 2) + L"-" + file->date.substr(0, 2);
+        ret = stmt->execute(recordsInfo.struct_id, file->fileNum, formattedDate);
+    }
+    else {
+        ret = stmt->execute(recordsInfo.struct_id, file->fileNum, file->time, file->filePrefix);
+    }
+    if (!SQL_SUCCEEDED(ret)) {
+        return;
+    }
+
+    if (stmt->fetch()) {
+        int hasData = 0, hasExpress = 0, hasOther = 0;
+        stmt->get(1, recordsInfo.data_id);
+        stmt->get(2, recordsInfo.dataProcess_id);
+        stmt->get(3, hasData);
+        stmt->get(4, hasExpress);
+        stmt->get(5, hasOther);
+        recordsInfo.hasDataBinary = hasData != 0;
+        recordsInfo.hasExpressBinary = hasExpress != 0;
+        recordsInfo.hasOtherBinary = hasOther != 0;
+    }
 }
 
 static void logSQLError(const std::string& message, SQLHANDLE handle, SQLSMALLINT type) {
@@ -311,91 +314,133 @@ static void logSQLError(const std::string& message, SQLHANDLE handle, SQLSMALLIN
     }
 }
 
-int Integration::insertIntoUnitTable(SQLHDBC dbc, const std::shared_ptr<BaseFile> file)
-{
-    SQLHSTMT hstmt = SQL_NULL_HSTMT;
-    SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, dbc, &hstmt);
-    if (!SQL_SUCCEEDED(ret)) {
-        logError(stringToWString("Failed to allocate SQL statement handle: insertInUnitTable"), INTEGRATION_LOG_PATH);
-        return -1;
+// Size of the pieces a file content is uploaded in
+static const size_t UPLOAD_CHUNK_SIZE = 64 * 1024;
+
+// Binding the content of a file as a data-at-execution parameter, the file itself is the token
+static SQLRETURN bindFileContent(SQLHSTMT hstmt, SQLUSMALLINT index, const BaseFile& file, SQLLEN& indicator) {
+    SQLLEN size = static_cast<SQLLEN>(file.contentSize());
+    indicator = SQL_LEN_DATA_AT_EXEC(size);
+    return SQLBindParameter(hstmt, index, SQL_PARAM_INPUT, SQL_C_BINARY, SQL_LONGVARBINARY,
+        size, 0, (SQLPOINTER)&file, 0, &indicator);
+}
+
+// Sending a file content in chunks, straight from disk if it was not loaded
+static bool putFileContent(SQLHSTMT hstmt, const BaseFile& file) {
+    if (!file.binaryData.empty()) {
+        for (size_t offset = 0; offset < file.binaryData.size(); offset += UPLOAD_CHUNK_SIZE) {
+            size_t length = (std::min)(UPLOAD_CHUNK_SIZE, file.binaryData.size() - offset);
+            if (!SQL_SUCCEEDED(SQLPutData(hstmt, (SQLPOINTER)(file.binaryData.data() + offset), static_cast<SQLLEN>(length)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The mapped pages go to the driver directly, no chunk is copied
+    FileView view(file.fullPath);
+    if (!view.valid()) {
+        logError(L"[Integration] Failed to open file for upload: " + file.fullPath, INTEGRATION_LOG_PATH);
+        return false;
+    }
+    if (view.size() != file.binaryDataSize) {
+        logError(L"[Integration] File changed during upload: " + file.fullPath, INTEGRATION_LOG_PATH);
+        return false;
+    }
+
+    for (size_t offset = 0; offset < view.size(); offset += UPLOAD_CHUNK_SIZE) {
+        size_t length = (std::min)(UPLOAD_CHUNK_SIZE, view.size() - offset);
+        if (!SQL_SUCCEEDED(SQLPutData(hstmt, (SQLPOINTER)(view.data() + offset), static_cast<SQLLEN>(length)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Answering SQL_NEED_DATA of an executed statement with the contents of its files
+static SQLRETURN sendFileContents(SQLHSTMT hstmt, SQLRETURN ret) {
+    while (ret == SQL_NEED_DATA) {
+        SQLPOINTER token = nullptr;
+        ret = SQLParamData(hstmt, &token);
+        if (ret == SQL_NEED_DATA && !putFileContent(hstmt, *static_cast<const BaseFile*>(token))) {
+            SQLCancel(hstmt);
+            return SQL_ERROR;
+        }
     }
+    return ret;
+}
 
+// Executing a statement with data-at-execution file contents
+static SQLRETURN executeWithFileContents(SQLHSTMT hstmt) {
+    return sendFileContents(hstmt, SQLExecute(hstmt));
+}
+
+// Bytes of file contents held in memory by a pair, tracked as a gauge
+static void recordBufferedBytes(const FileInfo& fileInfo) {
+    int64_t buffered = 0;
+    for (const auto& file : fileInfo.files) {
+        buffered += static_cast<int64_t>(file->binaryData.size());
+    }
+    Metrics::getInstance().setGauge("integration.file_bytes_in_memory", buffered);
+    Metrics::getInstance().sampleProcessMemory();
+}
+
+int Integration::insertIntoUnitTable(SQLHDBC dbc, const std::shared_ptr<BaseFile> file)
+{
     const wchar_t* sqlQuery = LR"(
         INSERT INTO [units] ([unit], [substation]) 
         OUTPUT INSERTED.id
         VALUES(?,?);
     )";
 
-    ret = SQLPrepareW(hstmt, (SQLWCHAR*)sqlQuery, SQL_NTS);
-    if (!SQL_SUCCEEDED(ret)) {
-        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
-        return -1 ;
+    // Workers of different recorders can meet on one unit, it is created only once
+    static std::mutex unitMutex;
+    std::lock_guard<std::mutex> lock(unitMutex);
+    int cachedId = ReferenceCache::getInstance().unitId(file->unit, file->substation);
+    if (cachedId != -1) {
+        return cachedId;
     }
 
-    ret = SQLBindParameter(hstmt, 1, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,
-        (SQLWCHAR*)file->unit.c_str(), 0, nullptr);
-    ret = SQLBindParameter(hstmt, 2, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,
-        (SQLWCHAR*)file->substation.c_str(), 0, nullptr);
+    StatementLease stmt = StatementCache::forConnection(dbc).acquire(sqlQuery);
+    if (!stmt) {
+        logError(stringToWString("Failed to prepare SQL statement: insertInUnitTable"), INTEGRATION_LOG_PATH);
+        return -1;
+    }
 
-    ret = SQLExecute(hstmt);
-    if (!SQL_SUCCEEDED(ret)) {
-        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    if (!SQL_SUCCEEDED(stmt->execute(file->unit, file->substation))) {
         return -1;
     }
 
     int unit_id = -1;
-    ret = SQLFetch(hstmt);
-    if (ret == SQL_SUCCESS) {
-        SQLGetData(hstmt, 1, SQL_C_SLONG, &unit_id, 0, nullptr);
+    if (stmt->fetch() && stmt->get(1, unit_id)) {
+        ReferenceCache::getInstance().addUnit(file->unit, file->substation, unit_id);
     }
-
-    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
     return unit_id;
 }
 
 int Integration::insertIntoStructTable(SQLHDBC dbc, const std::shared_ptr<BaseFile> file)
 {
-    SQLHSTMT hstmt = SQL_NULL_HSTMT;
-    SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, dbc, &hstmt);
-    if (!SQL_SUCCEEDED(ret)) {
-        logError(L"Failed to allocate SQL statement handle: insertIntoStructTable", INTEGRATION_LOG_PATH);
-        return -1;
-    }
-
     const wchar_t* sqlQuery = LR"(
         INSERT INTO [struct] ([recon_id], [object], [files_path]) 
         OUTPUT INSERTED.id
         VALUES(?,?,?);
     )";
 
-    ret = SQLPrepareW(hstmt, (SQLWCHAR*)sqlQuery, SQL_NTS);
-    if (!SQL_SUCCEEDED(ret)) {
-        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    StatementLease stmt = StatementCache::forConnection(dbc).acquire(sqlQuery);
+    if (!stmt) {
+        logError(L"Failed to prepare SQL statement: insertIntoStructTable", INTEGRATION_LOG_PATH);
         return -1;
     }
 
-    ret = SQLBindParameter(hstmt, 1, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 255, 0,      // [recon_id]
-        const_cast<int*>(&file->reconNumber), 0, nullptr);
-
-    ret = SQLBindParameter(hstmt, 2, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,    // [object]
-        (SQLWCHAR*)file->object.c_str(), 0, nullptr);
-
-    ret = SQLBindParameter(hstmt, 3, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,    // [files_path]
-        (SQLWCHAR*)file->parentFolderPath.c_str(), 0, nullptr);
-
-    ret = SQLExecute(hstmt);
-    if (!SQL_SUCCEEDED(ret)) {
-        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    // [recon_id], [object], [files_path]
+    if (!SQL_SUCCEEDED(stmt->execute(file->reconNumber, file->object, file->parentFolderPath))) {
         return -1;
     }
 
     int struct_id = -1;
-    ret = SQLFetch(hstmt);
-    if (ret == SQL_SUCCESS) {
-        SQLGetData(hstmt, 1, SQL_C_SLONG, &struct_id, 0, nullptr);
+    if (stmt->fetch() && stmt->get(1, struct_id)) {
+        ReferenceCache::getInstance().addStruct(file->reconNumber, file->object, struct_id);
     }
-
-    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
     return struct_id;
 }
 
@@ -536,17 +581,11 @@ int updateDataTable(SQLHDBC dbc, const FileInfo& fileInfo, RecordsInfoFromDB rec
             (SQLWCHAR*)expressFile->time.c_str(), expressFile->time.size() * sizeof(wchar_t), nullptr);
         if (!SQL_SUCCEEDED(ret)) return -1;
 
-        binarySize = static_cast<SQLLEN>(expressFile->binaryData.size());
-
-        ret = SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_BINARY, SQL_LONGVARBINARY,
-            binarySize, 0, (SQLPOINTER)expressFile->binaryData.data(), binarySize, &binarySize);
+        ret = bindFileContent(hstmt, paramIndex++, *expressFile, binarySize);
         if (!SQL_SUCCEEDED(ret)) return -1;
     }
     else if (fileInfo.hasDataFile && dataFile != nullptr && !recordsInfo.hasDataBinary ) {
-        binarySize = static_cast<SQLLEN>(dataFile->binaryData.size());
-
-        ret = SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_BINARY, SQL_LONGVARBINARY, 
-            binarySize, 0, (SQLPOINTER)dataFile->binaryData.data(), binarySize, &binarySize);
+        ret = bindFileContent(hstmt, paramIndex++, *dataFile, binarySize);
         if (!SQL_SUCCEEDED(ret)) return -1;
     }
 
@@ -566,7 +605,8 @@ int updateDataTable(SQLHDBC dbc, const FileInfo& fileInfo, RecordsInfoFromDB rec
         (SQLWCHAR*)formattedDate.c_str(), formattedDate.size() * sizeof(wchar_t), nullptr);
     if (!SQL_SUCCEEDED(ret)) return -1;
 
-    ret = SQLExecute(hstmt);
+    recordBufferedBytes(fileInfo);
+    ret = executeWithFileContents(hstmt);
     if (!SQL_SUCCEEDED(ret)) {
         logSQLError("Failed to execute update query in updateDataTable", hstmt, SQL_HANDLE_STMT);
         SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
@@ -623,10 +663,15 @@ int Integration::insertIntoDataTable(SQLHDBC dbc, const FileInfo& fileInfo, Reco
     std::wstring formattedDate = file->date.substr(6, 4) + L"-" + file->date.substr(3, 2) + L"-" + file->date.substr(0, 2);
     std::wstring formattedTime = file->time;
 
-    if (file->binaryData.empty() || file->binaryDataSize == 0) {
+    if (!file->hasContent()) {
 		return -1; // No binary data to insert
     }
 
+    int allocatedId = -1;
+    if (!takeDataId(dbc, allocatedId)) {
+        return -1;
+    }
+
     SQLHSTMT hstmt = SQL_NULL_HSTMT;
     SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, dbc, &hstmt);
     if (!SQL_SUCCEEDED(ret)) {
@@ -643,35 +688,39 @@ int Integration::insertIntoDataTable(SQLHDBC dbc, const FileInfo& fileInfo, Reco
         OUTPUT INSERTED.id
         VALUES(?, ?, ?, ?)";
 
+    if (allocatedId != -1) {
+        sqlQuery += L", [id]";
+        values = L" VALUES(?, ?, ?, ?, ?";
+    }
+
     int paramIndex = 1;
     std::vector<SQLLEN> fileSizes;
-    std::vector<void*> filePointers;
+    std::vector<const BaseFile*> uploadFiles;
 
     // собираем данные
     if (dataFile && dataFile->hasDataFile) {
-        if (!dataFile->binaryData.empty()) {
+        if (dataFile->hasContent()) {
             sqlQuery += L", [data_file]";
             values += L", ?";
-            filePointers.push_back((void*)dataFile->binaryData.data());
-            fileSizes.push_back(static_cast<SQLLEN>(dataFile->binaryData.size()));
+            uploadFiles.push_back(dataFile.get());
         }
     }
     if (expressFile && expressFile->hasExpressFile) {
-        if (!expressFile->binaryData.empty()) {        
+        if (expressFile->hasContent()) {        
             sqlQuery += L", [express_file]";
             values += L", ?";
-            filePointers.push_back((void*)expressFile->binaryData.data());
-            fileSizes.push_back(static_cast<SQLLEN>(expressFile->binaryData.size()));
+            uploadFiles.push_back(expressFile.get());
         }
     }
     if (baseFile && !expressFile && !dataFile) {
-        if (!baseFile->binaryData.empty()) {
+        if (baseFile->hasContent()) {
             sqlQuery += L", [other_type_file], [file_type]";
             values += L", ?, ?";
-            filePointers.push_back((void*)baseFile->binaryData.data());
-            fileSizes.push_back(static_cast<SQLLEN>(baseFile->binaryData.size()));
+            uploadFiles.push_back(baseFile.get());
         }
     }
+    // Indicators are read by the driver at execution, they must not move
+    fileSizes.resize(uploadFiles.size());
 
     // Completing the SQL query
     sqlQuery += L") " + values + L");";
@@ -702,15 +751,15 @@ int Integration::insertIntoDataTable(SQLHDBC dbc, const FileInfo& fileInfo, Reco
         (SQLWCHAR*)fileNum.c_str(), 0, nullptr);
     if (!SQL_SUCCEEDED(ret)) logSQLError("Failed to bind file_num", hstmt, SQL_HANDLE_STMT);
 
-    // Bind binary files
-    for (size_t i = 0; i < filePointers.size(); ++i) {
-        void* binData = filePointers[i];
-        SQLLEN* binSize = &fileSizes[i];  
+    if (allocatedId != -1) {
+        ret = SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0,
+            &allocatedId, 0, nullptr);
+        if (!SQL_SUCCEEDED(ret)) logSQLError("Failed to bind id", hstmt, SQL_HANDLE_STMT);
+    }
 
-		// Bind the binary data
-        ret = SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, 
-            SQL_C_BINARY, SQL_LONGVARBINARY,
-            *binSize, 0, binData, *binSize, binSize);
+    // Bind binary files, their contents are sent in chunks during execution
+    for (size_t i = 0; i < uploadFiles.size(); ++i) {
+        ret = bindFileContent(hstmt, paramIndex++, *uploadFiles[i], fileSizes[i]);
         
         if (!SQL_SUCCEEDED(ret)) {
             logSQLError("Failed to bind binary file", hstmt, SQL_HANDLE_STMT);
@@ -723,15 +772,27 @@ int Integration::insertIntoDataTable(SQLHDBC dbc, const FileInfo& fileInfo, Reco
         if (!SQL_SUCCEEDED(ret)) logSQLError("Failed to bind file_num", hstmt, SQL_HANDLE_STMT);
     }
 
-    ret = SQLExecute(hstmt);
+    recordBufferedBytes(fileInfo);
+    if (allocatedId != -1 && !setDataIdentityInsert(dbc, true)) {
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        return -1;
+    }
+    ret = executeWithFileContents(hstmt);
+    if (allocatedId != -1) {
+        setDataIdentityInsert(dbc, false);
+    }
     if (!SQL_SUCCEEDED(ret)) {
         logSQLError("Failed to execute SQL query in insertIntoDataTable", hstmt, SQL_HANDLE_STMT);
         SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        // The block may overlap rows inserted by someone else, the next insert takes a fresh one
+        if (allocatedId != -1) {
+            dataIds.discard();
+        }
         return -1;
     }
 
-    int data_id = -1;
-    if (SQLFetch(hstmt) == SQL_SUCCESS) {
+    int data_id = allocatedId;
+    if (allocatedId == -1 && SQLFetch(hstmt) == SQL_SUCCESS) {
         SQLGetData(hstmt, 1, SQL_C_SLONG, &data_id, 0, nullptr);
     }
 
@@ -739,60 +800,378 @@ int Integration::insertIntoDataTable(SQLHDBC dbc, const FileInfo& fileInfo, Reco
     return data_id;
 }
 
-int Integration::insertIntoProcessTable(SQLHDBC dbc, const std::shared_ptr<BaseFile> file, int data_id)
-{
-    auto expressFile = std::dynamic_pointer_cast<ExpressFile>(file);
-    if (!expressFile) {
-        logError(L"[Integration::insertIntoProcessTable] Expected ExpressFile but got something else", INTEGRATION_LOG_PATH);
-        return -1;
+// Content of a file sent with SQLPutData, bound as the buffer of a data-at-execution parameter
+struct BlobRef {
+    const char* data = nullptr;
+    SQLLEN size = 0;
+};
+
+// Binary columns of the data table
+enum DataColumn { DataFileColumn, ExpressFileColumn, OtherFileColumn, DataColumnCount };
+
+// One element of the parameter array of a batch insert, bound row-wise
+struct DataRow {
+    SQLINTEGER id = 0;                  // Allocated id, unused when the server generates it
+    SQLINTEGER structId = 0;
+    SQLWCHAR date[16] = {};
+    SQLWCHAR time[32] = {};
+    SQLWCHAR fileNum[16] = {};
+    SQLWCHAR fileType[16] = {};
+    SQLLEN textLen = SQL_NTS;
+    BlobRef blobs[DataColumnCount];
+    SQLLEN blobLen[DataColumnCount] = {};
+};
+
+// One element of the parameter array of the data_process insert of a batch
+struct ProcessRow {
+    SQLINTEGER id = 0;
+    SQLWCHAR damagedLine[256] = {};
+    SQLWCHAR trigger[256] = {};
+    SQLWCHAR eventType[256] = {};
+    SQLLEN textLen = SQL_NTS;
+};
+
+static void copyParameter(SQLWCHAR* target, size_t capacity, const std::wstring& value) {
+    size_t length = (std::min)(value.size(), capacity - 1);
+    std::copy(value.begin(), value.begin() + length, target);
+    target[length] = 0;
+}
+
+// The same choice of binary columns as insertIntoDataTable, returned as a bit mask of DataColumn
+static int selectDataColumns(const FileInfo& fileInfo, BlobRef (&blobs)[DataColumnCount]) {
+    std::shared_ptr<ExpressFile> expressFile = nullptr;
+    std::shared_ptr<DataFile> dataFile = nullptr;
+    std::shared_ptr<BaseFile> baseFile = nullptr;
+
+    for (const auto& file : fileInfo.files) {
+        if (auto ef = std::dynamic_pointer_cast<ExpressFile>(file)) {
+            expressFile = ef;
+        }
+        else if (auto df = std::dynamic_pointer_cast<DataFile>(file)) {
+            dataFile = df;
+        }
+        else {
+            baseFile = file;
+        }
     }
 
+    int columns = 0;
+    if (dataFile && dataFile->hasDataFile && !dataFile->binaryData.empty()) {
+        blobs[DataFileColumn] = { dataFile->binaryData.data(), static_cast<SQLLEN>(dataFile->binaryData.size()) };
+        columns |= 1 << DataFileColumn;
+    }
+    if (expressFile && expressFile->hasExpressFile && !expressFile->binaryData.empty()) {
+        blobs[ExpressFileColumn] = { expressFile->binaryData.data(), static_cast<SQLLEN>(expressFile->binaryData.size()) };
+        columns |= 1 << ExpressFileColumn;
+    }
+    if (baseFile && !expressFile && !dataFile && !baseFile->binaryData.empty()) {
+        blobs[OtherFileColumn] = { baseFile->binaryData.data(), static_cast<SQLLEN>(baseFile->binaryData.size()) };
+        columns |= 1 << OtherFileColumn;
+    }
+    return columns;
+}
+
+// Executing one INSERT for all rows with the same binary columns. With explicit ids the rows carry
+// their allocated id, otherwise the generated ids are appended in row order
+static bool executeDataRows(SQLHDBC dbc, int columns, std::vector<DataRow>& rows, std::vector<int>& ids, bool explicitIds) {
     SQLHSTMT hstmt = SQL_NULL_HSTMT;
     SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, dbc, &hstmt);
     if (!SQL_SUCCEEDED(ret)) {
-        logError(L"Failed to allocate SQL statement handle: insertIntoProcessTable", INTEGRATION_LOG_PATH);
-        return -1;
+        logError(L"Failed to allocate SQL statement handle: insertIntoDataTableBatch", INTEGRATION_LOG_PATH);
+        return false;
+    }
+
+    std::wstring sqlQuery = LR"(
+        INSERT INTO [data] 
+        ([struct_id], [date], [time], [file_num]
+    )";
+
+    std::wstring values = LR"(
+        OUTPUT INSERTED.id
+        VALUES(?, ?, ?, ?)";
+
+    if (explicitIds) {
+        sqlQuery += L", [id]";
+        values = L" VALUES(?, ?, ?, ?, ?";
+    }
+    if (columns & (1 << DataFileColumn)) {
+        sqlQuery += L", [data_file]";
+        values += L", ?";
+    }
+    if (columns & (1 << ExpressFileColumn)) {
+        sqlQuery += L", [express_file]";
+        values += L", ?";
+    }
+    if (columns & (1 << OtherFileColumn)) {
+        sqlQuery += L", [other_type_file], [file_type]";
+        values += L", ?, ?";
+    }
+    sqlQuery += L") " + values + L");";
+
+    ret = SQLPrepareW(hstmt, (SQLWCHAR*)sqlQuery.c_str(), SQL_NTS);
+    if (!SQL_SUCCEEDED(ret)) {
+        logSQLError("Failed to prepare batch insert into data", hstmt, SQL_HANDLE_STMT);
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        return false;
+    }
+
+    // Every bound address below is the one of the first row, the driver steps by sizeof(DataRow)
+    SQLSetStmtAttr(hstmt, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER)sizeof(DataRow), 0);
+    SQLSetStmtAttr(hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)rows.size(), 0);
+
+    DataRow& first = rows.front();
+    int paramIndex = 1;
+    SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0,
+        &first.structId, 0, nullptr);
+    SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 10, 0,
+        first.date, sizeof(first.date), &first.textLen);
+    SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 30, 0,
+        first.time, sizeof(first.time), &first.textLen);
+    SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,
+        first.fileNum, sizeof(first.fileNum), &first.textLen);
+    if (explicitIds) {
+        SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0,
+            &first.id, 0, nullptr);
+    }
+
+    // File contents are data-at-execution: the driver asks for them one by one instead of copying the arrays
+    for (int column = 0; column < DataColumnCount; ++column) {
+        if (!(columns & (1 << column))) {
+            continue;
+        }
+        SQLLEN maxSize = 0;
+        for (const auto& row : rows) {
+            maxSize = (std::max)(maxSize, row.blobs[column].size);
+        }
+        ret = SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_BINARY, SQL_LONGVARBINARY,
+            maxSize, 0, &first.blobs[column], 0, &first.blobLen[column]);
+        if (!SQL_SUCCEEDED(ret)) logSQLError("Failed to bind binary file", hstmt, SQL_HANDLE_STMT);
+    }
+    if (columns & (1 << OtherFileColumn)) {
+        SQLBindParameter(hstmt, paramIndex++, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,
+            first.fileType, sizeof(first.fileType), &first.textLen);
+    }
+
+    ret = SQLExecute(hstmt);
+    while (ret == SQL_NEED_DATA) {
+        SQLPOINTER token = nullptr;
+        ret = SQLParamData(hstmt, &token);
+        if (ret == SQL_NEED_DATA) {
+            // The token is the address of the BlobRef in the row the driver is working on
+            const BlobRef* blob = static_cast<const BlobRef*>(token);
+            SQLPutData(hstmt, (SQLPOINTER)blob->data, blob->size);
+        }
+    }
+    if (!SQL_SUCCEEDED(ret)) {
+        logSQLError("Failed to execute batch insert into data", hstmt, SQL_HANDLE_STMT);
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        return false;
+    }
+
+    if (explicitIds) {
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        for (const auto& row : rows) {
+            ids.push_back(row.id);
+        }
+        return true;
+    }
+
+    // Every parameter set produces its own OUTPUT result
+    size_t fetched = 0;
+    do {
+        SQLSMALLINT resultColumns = 0;
+        SQLNumResultCols(hstmt, &resultColumns);
+        if (resultColumns == 0) {
+            continue;
+        }
+        while (SQLFetch(hstmt) == SQL_SUCCESS) {
+            int data_id = -1;
+            SQLGetData(hstmt, 1, SQL_C_SLONG, &data_id, 0, nullptr);
+            ids.push_back(data_id);
+            ++fetched;
+        }
+    } while (SQL_SUCCEEDED(SQLMoreResults(hstmt)));
+
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    if (fetched != rows.size()) {
+        logError(L"[Integration] Batch insert into data returned " + std::to_wstring(fetched) + L" ids for " +
+            std::to_wstring(rows.size()) + L" rows", INTEGRATION_LOG_PATH);
+        return false;
+    }
+    return true;
+}
+
+// Inserting the data_process rows of a batch whose data ids are already known
+static bool executeProcessRows(SQLHDBC dbc, std::vector<ProcessRow>& rows) {
+    SQLHSTMT hstmt = SQL_NULL_HSTMT;
+    SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, dbc, &hstmt);
+    if (!SQL_SUCCEEDED(ret)) {
+        logError(L"Failed to allocate SQL statement handle: executeProcessRows", INTEGRATION_LOG_PATH);
+        return false;
     }
 
     const wchar_t* sqlQuery = LR"(
-        SET TRANSACTION ISOLATION LEVEL READ COMMITTED;
         INSERT INTO [data_process] ([id], [damaged_line], [trigger], [event_type]) 
-        OUTPUT INSERTED.id
         VALUES(?, ?, ?, ?);
     )";
 
     ret = SQLPrepareW(hstmt, (SQLWCHAR*)sqlQuery, SQL_NTS);
     if (!SQL_SUCCEEDED(ret)) {
+        logSQLError("Failed to prepare batch insert into data_process", hstmt, SQL_HANDLE_STMT);
         SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
-        return -1;
+        return false;
     }
 
-    ret = SQLBindParameter(hstmt, 1, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 255, 0,                          
-        const_cast<int*>(&data_id), 0, nullptr);
-    if (!SQL_SUCCEEDED(ret)) logSQLError("Failed to bind parameter 1", hstmt, SQL_HANDLE_STMT);
+    SQLSetStmtAttr(hstmt, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER)sizeof(ProcessRow), 0);
+    SQLSetStmtAttr(hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)rows.size(), 0);
 
-    ret = SQLBindParameter(hstmt, 2, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,      
-        (SQLWCHAR*)expressFile->damagedLine.c_str(), 0, nullptr);
-    if (!SQL_SUCCEEDED(ret)) logSQLError("Failed to bind parameter 2", hstmt, SQL_HANDLE_STMT);
+    ProcessRow& first = rows.front();
+    SQLBindParameter(hstmt, 1, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 0, 0, &first.id, 0, nullptr);
+    SQLBindParameter(hstmt, 2, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,
+        first.damagedLine, sizeof(first.damagedLine), &first.textLen);
+    SQLBindParameter(hstmt, 3, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,
+        first.trigger, sizeof(first.trigger), &first.textLen);
+    SQLBindParameter(hstmt, 4, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,
+        first.eventType, sizeof(first.eventType), &first.textLen);
+
+    ret = SQLExecute(hstmt);
+    if (!SQL_SUCCEEDED(ret)) {
+        logSQLError("Failed to execute batch insert into data_process", hstmt, SQL_HANDLE_STMT);
+    }
+    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    return SQL_SUCCEEDED(ret);
+}
 
-    ret = SQLBindParameter(hstmt, 3, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,
-        (SQLWCHAR*)expressFile->factor.c_str(), 0, nullptr);
-    if (!SQL_SUCCEEDED(ret)) logSQLError("Failed to bind parameter 3", hstmt, SQL_HANDLE_STMT);
+std::vector<int> Integration::insertIntoDataTableBatch(SQLHDBC dbc, std::vector<DataBatch::Entry>& entries)
+{
+    // Rows are grouped by their binary columns, the absent ones keep their defaults as in the single-row insert
+    std::map<int, std::vector<size_t>> groups;
+    std::vector<DataRow> rows(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const DataBatch::Entry& entry = entries[i];
+        DataRow& row = rows[i];
+        const std::wstring& date = entry.file->date;
+
+        row.structId = entry.recordsInfo.struct_id;
+        copyParameter(row.date, 16, date.substr(6, 4) + L"-" + date.substr(3, 2) + L"-" + date.substr(0, 2));
+        copyParameter(row.time, 32, entry.file->time);
+        copyParameter(row.fileNum, 16, entry.file->fileNum);
+        copyParameter(row.fileType, 16, entry.file->filePrefix);
+
+        int columns = selectDataColumns(entry.fileInfo, row.blobs);
+        for (int column = 0; column < DataColumnCount; ++column) {
+            row.blobLen[column] = (columns & (1 << column)) ? SQL_LEN_DATA_AT_EXEC(row.blobs[column].size) : SQL_NULL_DATA;
+        }
+        groups[columns].push_back(i);
+    }
+
+    // With ids allocated up front nothing waits for OUTPUT, the data_process rows follow in the same transaction
+    std::vector<int> allocated;
+    bool explicitIds = explicitDataIds;
+    if (explicitIds && !dataIds.allocate(dbc, entries.size(), allocated)) {
+        return std::vector<int>();
+    }
+    std::vector<ProcessRow> processRows;
+    std::vector<size_t> processEntries;
+    if (explicitIds) {
+        for (size_t i = 0; i < entries.size(); ++i) {
+            rows[i].id = allocated[i];
+
+            auto expressFile = std::dynamic_pointer_cast<ExpressFile>(entries[i].file);
+            if (entries[i].recordsInfo.needDataProcess && expressFile) {
+                ProcessRow processRow;
+                processRow.id = allocated[i];
+                copyParameter(processRow.damagedLine, 256, expressFile->damagedLine);
+                copyParameter(processRow.trigger, 256, expressFile->factor);
+                copyParameter(processRow.eventType, 256, expressFile->typeKz);
+                processRows.push_back(processRow);
+                processEntries.push_back(i);
+            }
+        }
+    }
 
-    ret = SQLBindParameter(hstmt, 4, SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR, 255, 0,
-        (SQLWCHAR*)expressFile->typeKz.c_str(), 0, nullptr);
-    if (!SQL_SUCCEEDED(ret)) logSQLError("Failed to bind parameter 4", hstmt, SQL_HANDLE_STMT);
+    // One transaction for the whole batch: either every row gets its id or none is written
+    SQLSetConnectAttr(dbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_OFF, 0);
+
+    if (explicitIds && !setDataIdentityInsert(dbc, true)) {
+        SQLSetConnectAttr(dbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_ON, 0);
+        return std::vector<int>();
+    }
+
+    std::vector<int> ids(entries.size(), -1);
+    bool succeeded = true;
+    for (const auto& group : groups) {
+        std::vector<DataRow> groupRows;
+        groupRows.reserve(group.second.size());
+        for (size_t index : group.second) {
+            groupRows.push_back(rows[index]);
+        }
+
+        std::vector<int> groupIds;
+        if (!executeDataRows(dbc, group.first, groupRows, groupIds, explicitIds)) {
+            succeeded = false;
+            break;
+        }
+        for (size_t i = 0; i < group.second.size(); ++i) {
+            ids[group.second[i]] = groupIds[i];
+        }
+    }
+
+    if (explicitIds) {
+        if (succeeded && !processRows.empty()) {
+            succeeded = executeProcessRows(dbc, processRows);
+        }
+        setDataIdentityInsert(dbc, false);
+    }
+
+    SQLEndTran(SQL_HANDLE_DBC, dbc, succeeded ? SQL_COMMIT : SQL_ROLLBACK);
+    SQLSetConnectAttr(dbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_ON, 0);
+
+    if (!succeeded) {
+        // The block may overlap rows inserted by someone else, the next batch takes a fresh one
+        dataIds.discard();
+        return std::vector<int>();
+    }
+
+    // The data_process rows are written, finishDataRecord only adds the logs
+    for (size_t index : processEntries) {
+        entries[index].recordsInfo.dataProcess_id = rows[index].id;
+    }
+    return ids;
+}
+
+int Integration::insertIntoProcessTable(SQLHDBC dbc, const std::shared_ptr<BaseFile> file, int data_id)
+{
+    auto expressFile = std::dynamic_pointer_cast<ExpressFile>(file);
+    if (!expressFile) {
+        logError(L"[Integration::insertIntoProcessTable] Expected ExpressFile but got something else", INTEGRATION_LOG_PATH);
+        return -1;
+    }
+
+    const wchar_t* sqlQuery = LR"(
+        SET TRANSACTION ISOLATION LEVEL READ COMMITTED;
+        INSERT INTO [data_process] ([id], [damaged_line], [trigger], [event_type]) 
+        OUTPUT INSERTED.id
+        VALUES(?, ?, ?, ?);
+    )";
+
+    StatementLease stmt = StatementCache::forConnection(dbc).acquire(sqlQuery);
+    if (!stmt) {
+        logError(L"Failed to prepare SQL statement: insertIntoProcessTable", INTEGRATION_LOG_PATH);
+        return -1;
+    }
 
     const int maxRetries = 3;
     int attempt = 0;
+    SQLRETURN ret;
     while (attempt < maxRetries) {
-        ret = SQLExecute(hstmt);
+        ret = stmt->execute(data_id, expressFile->damagedLine, expressFile->factor, expressFile->typeKz);
         if (SQL_SUCCEEDED(ret)) break; 
         if (ret == SQL_ERROR) {
             SQLINTEGER nativeError;
             SQLCHAR sqlState[6], errorMsg[256];
             SQLSMALLINT textLength;
-            SQLGetDiagRecA(SQL_HANDLE_STMT, hstmt, 1, sqlState, &nativeError, errorMsg, sizeof(errorMsg), &textLength);
+            SQLGetDiagRecA(SQL_HANDLE_STMT, stmt->handle(), 1, sqlState, &nativeError, errorMsg, sizeof(errorMsg), &textLength);
 
             if (nativeError == 1205) { // Deadlock
                 std::this_thread::sleep_for(std::chrono::milliseconds(200)); // Пауза перед повтором
@@ -800,18 +1179,14 @@ int Integration::insertIntoProcessTable(SQLHDBC dbc, const std::shared_ptr<BaseF
                 continue;
             }
         }
-        logSQLError("Failed to execute SQL query in function 'insertIntoProcessTable", hstmt, SQL_HANDLE_STMT);
-        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+        logSQLError("Failed to execute SQL query in function 'insertIntoProcessTable", stmt->handle(), SQL_HANDLE_STMT);
         return -1;
     }
 
     int dataProcess_id = -1;
-    ret = SQLFetch(hstmt);
-    if (ret == SQL_SUCCESS) {
-        SQLGetData(hstmt, 1, SQL_C_SLONG, &dataProcess_id, 0, nullptr);
+    if (stmt->fetch()) {
+        stmt->get(1, dataProcess_id);
     }
-
-    SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
     return dataProcess_id;
 }
 
@@ -1078,14 +1453,149 @@ void sendMailIfActive(
 }
 
 
+// Sink of the pipeline stage running on this thread, see setNotificationSink
+static thread_local std::vector<RecordNotification>* notificationSink = nullptr;
+
+void Integration::setNotificationSink(std::vector<RecordNotification>* sink)
+{
+    notificationSink = sink;
+}
+
+void Integration::notifyRecord(SQLHDBC dbc, bool mailingIsActive, const std::wstring& substation, const FileInfo& fileInfo)
+{
+    if (!notificationSink) {
+        sendMailIfActive(mailingIsActive, substation, fileInfo, dbc);
+        return;
+    }
+    if (mailingIsActive) {
+        notificationSink->push_back(RecordNotification{ substation, fileInfo });
+    }
+}
+
+void Integration::sendRecordMail(SQLHDBC dbc, bool mailingIsActive, const RecordNotification& notification)
+{
+    sendMailIfActive(mailingIsActive, notification.substation, notification.fileInfo, dbc);
+}
+
+// Content of a file as a streamed parameter, NULL if there is none
+static SqlStream fileStream(const std::shared_ptr<BaseFile>& file) {
+    SqlStream stream;
+    if (file && file->hasContent()) {
+        stream.token = file.get();
+        stream.size = static_cast<SQLLEN>(file->contentSize());
+    }
+    return stream;
+}
+
+bool Integration::upsertFileRecord(SQLHDBC dbc, const FileInfo& fileInfo, std::shared_ptr<BaseFile> file,
+    RecordsInfoFromDB& recordsInfo, bool updateLogs, bool& dataChanged)
+{
+    std::shared_ptr<ExpressFile> expressFile = nullptr;
+    std::shared_ptr<DataFile> dataFile = nullptr;
+    std::shared_ptr<BaseFile> otherFile = nullptr;
+
+    for (const auto& f : fileInfo.files) {
+        if (auto ef = std::dynamic_pointer_cast<ExpressFile>(f)) {
+            expressFile = ef;
+        }
+        else if (auto df = std::dynamic_pointer_cast<DataFile>(f)) {
+            dataFile = df;
+        }
+        else {
+            otherFile = f;
+        }
+    }
+
+    // Same columns as insertIntoDataTable fills
+    SqlStream dataContent = fileStream(dataFile && dataFile->hasDataFile ? dataFile : nullptr);
+    SqlStream expressContent = fileStream(expressFile && expressFile->hasExpressFile ? expressFile : nullptr);
+    SqlStream otherContent = fileStream(!expressFile && !dataFile ? otherFile : nullptr);
+
+    std::wstring formattedDate = file->date.substr(6, 4) + L"-" + file->date.substr(3, 2) + L"-" + file->date.substr(0, 2);
+
+    std::wstring lastPing = formatDateTime(Ftp::getInstance().getLastPing(file->reconNumber));
+    std::wstring lastRecon;
+    std::wstring lastDaily;
+    if (expressFile && dataFile) {
+        lastRecon = ConvertToSqlDateTimeFormat(expressFile->date, expressFile->time);
+    }
+    if (file->filePrefix == L"DAILY") {
+        lastDaily = ConvertToSqlDateTimeFormat(file->date, file->time);
+    }
+
+    std::wstring damagedLine, trigger, eventType;
+    if (expressFile) {
+        damagedLine = expressFile->damagedLine;
+        trigger = expressFile->factor;
+        eventType = expressFile->typeKz;
+    }
+
+    // Taken even if the row turns out to exist, an unused id only leaves a gap
+    int newDataId = -1;
+    if (!takeDataId(dbc, newDataId)) {
+        return false;
+    }
+
+    StatementLease stmt = StatementCache::forConnection(dbc).acquire(
+        L"{CALL [integrate_file_record](?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)}");
+    if (!stmt) {
+        return false;
+    }
+
+    // Bound by address and read while the contents are streamed, so they must outlive sendFileContents
+    int needProcess = recordsInfo.needDataProcess ? 1 : 0;
+    int logsUpdate = updateLogs ? 1 : 0;
+
+    recordBufferedBytes(fileInfo);
+    SQLRETURN ret = stmt->execute(file->unit, file->substation, file->reconNumber, file->object, file->parentFolderPath,
+        file->fileNum, formattedDate, file->time, file->filePrefix,
+        dataContent, expressContent, otherContent,
+        needProcess, damagedLine, trigger, eventType,
+        logsUpdate, lastPing, lastRecon, lastDaily, newDataId);
+    ret = sendFileContents(stmt->handle(), ret);
+    if (!SQL_SUCCEEDED(ret)) {
+        SQLWCHAR sqlState[6];
+        SQLINTEGER nativeError = 0;
+        SQLSMALLINT textLength;
+        SQLWCHAR messageText[SQL_MAX_MESSAGE_LENGTH];
+        SQLGetDiagRecW(SQL_HANDLE_STMT, stmt->handle(), 1, sqlState, &nativeError, messageText, SQL_MAX_MESSAGE_LENGTH, &textLength);
+        if (nativeError == 2812) { // Could not find stored procedure
+            Database::disableUpsertProcedure();
+        }
+        logSQLError("Failed to execute integrate_file_record, falling back to separate statements", stmt->handle(), SQL_HANDLE_STMT);
+        if (newDataId != -1) {
+            dataIds.discard();
+        }
+        return false;
+    }
+
+    int changed = 0;
+    if (!stmt->fetch()) {
+        return false;
+    }
+    stmt->get(1, recordsInfo.unit_id);
+    stmt->get(2, recordsInfo.struct_id);
+    stmt->get(3, recordsInfo.data_id);
+    stmt->get(4, recordsInfo.dataProcess_id);
+    stmt->get(5, changed);
+    dataChanged = changed != 0;
+
+    ReferenceCache& references = ReferenceCache::getInstance();
+    references.addUnit(file->unit, file->substation, recordsInfo.unit_id);
+    references.addStruct(file->reconNumber, file->object, recordsInfo.struct_id);
+    references.addStructUnit(recordsInfo.unit_id, recordsInfo.struct_id);
+    return true;
+}
+
 // Integration of information into the database
-void Integration::fileIntegrationDB(SQLHDBC dbc, const FileInfo& fileInfo, std::atomic_bool& mailingIsActive, std::atomic_bool& dbIsFull) {
+RecordWrite Integration::fileIntegrationDB(SQLHDBC dbc, const FileInfo& fileInfo, std::atomic_bool& mailingIsActive, std::atomic_bool& dbIsFull,
+    DataBatch* batch) {
     try {
         //logIntegrationError(L"[Integration] file integration was started");
         // Control DB connection
         if (dbc == nullptr) {
             logError(L"[Integration]: No connection to the database", INTEGRATION_LOG_PATH);
-            return;
+            return RecordWrite::Failed;
         }
 
         size_t filesCount = fileInfo.files.size();
@@ -1108,7 +1618,7 @@ void Integration::fileIntegrationDB(SQLHDBC dbc, const FileInfo& fileInfo, std::
                 }
                 else {
                     logError(L"[Integration] Unknown file type in fileInfo.files.", INTEGRATION_LOG_PATH);
-                    return;
+                    return RecordWrite::Failed;
                 }
             }
             break;
@@ -1124,17 +1634,37 @@ void Integration::fileIntegrationDB(SQLHDBC dbc, const FileInfo& fileInfo, std::
                 }
                 else {
                     logError(L"[Integration] Unknown file type in fileInfo.files.", INTEGRATION_LOG_PATH);
-                    return;
+                    return RecordWrite::Failed;
                 }
             }
             break;
 
         default:
-            return;
+            return RecordWrite::Failed;
         }
 
         if (file->date.size() < 10 )  // Date format should be like - 29/07/2024
-            return;      
+            return RecordWrite::Failed;
+
+        // The other file of a queued pair must see the row, so the batch is written first
+        std::wstring rowKey;
+        if (batch) {
+            rowKey = dataRowKey(*file);
+            if (batch->contains(rowKey)) {
+                flushDataBatch(dbc, *batch, mailingIsActive, dbIsFull);
+            }
+        }
+
+        // One round trip per record when the server has the procedure. Bulk scans keep the array-bound inserts
+        if (!batch && Database::hasUpsertProcedure()) {
+            bool dataChanged = false;
+            if (upsertFileRecord(dbc, fileInfo, file, recordsInfo, dbIsFull, dataChanged)) {
+                if (dataChanged) {
+                    notifyRecord(dbc, mailingIsActive, file->substation, fileInfo);
+                }
+                return RecordWrite::Written;
+            }
+        }
 
         // Insert into dbo.units (if it does not exist) 
         getRecordInfo(dbc, file, recordsInfo);
@@ -1143,7 +1673,7 @@ void Integration::fileIntegrationDB(SQLHDBC dbc, const FileInfo& fileInfo, std::
             recordsInfo.unit_id = insertIntoUnitTable(dbc, file);
 
             if (recordsInfo.unit_id == -1)
-                return;
+                return RecordWrite::Failed;
         }
 
         // Insert into dbo.struct (if it does not exist)
@@ -1151,37 +1681,65 @@ void Integration::fileIntegrationDB(SQLHDBC dbc, const FileInfo& fileInfo, std::
             recordsInfo.struct_id = insertIntoStructTable(dbc, file);
 
             if (recordsInfo.struct_id == -1)
-                return;
+                return RecordWrite::Failed;
         }
 
         // Insert into dbo.[struct_units] (if it does not exist)
-        if (recordsInfo.struct_id != -1) {
-            std::wstringstream sqlCheckStructUnits;
-            sqlCheckStructUnits << L"SELECT COUNT(*) FROM [struct_units] WHERE [unit_id] = " << recordsInfo.unit_id
-                << L" AND [struct_id] = " << recordsInfo.struct_id << L";";
-            int count = Database::executeSQLAndGetIntResult(dbc, sqlCheckStructUnits);
-            if (count == 0) {
-                std::wstringstream sqlStructUnits;
-                sqlStructUnits << L"INSERT INTO [struct_units] ([unit_id], [struct_id]) VALUES ("
-                    << recordsInfo.unit_id << L", "     // [unit_id]
-                    << recordsInfo.struct_id << L");";  // [struct_id]
-
-                if (!Database::executeSQL(dbc, sqlStructUnits)) {
-                    return;
-                }
+        if (recordsInfo.struct_id != -1 && !ReferenceCache::getInstance().hasStructUnit(recordsInfo.unit_id, recordsInfo.struct_id)) {
+            StatementLease stmt = StatementCache::forConnection(dbc).acquire(LR"(
+                IF NOT EXISTS (SELECT 1 FROM [struct_units] WHERE [unit_id] = ? AND [struct_id] = ?)
+                    INSERT INTO [struct_units] ([unit_id], [struct_id]) VALUES(?, ?);
+            )");
+            if (!stmt) {
+                logError(L"Failed to prepare SQL statement: struct_units", INTEGRATION_LOG_PATH);
+                return RecordWrite::Failed;
+            }
+
+            // [unit_id], [struct_id] of the check and of the insert
+            SQLRETURN ret = stmt->execute(recordsInfo.unit_id, recordsInfo.struct_id, recordsInfo.unit_id, recordsInfo.struct_id);
+            if (!SQL_SUCCEEDED(ret) && ret != SQL_NO_DATA) {
+                logSQLError("Failed to execute SQL query for struct_units", stmt->handle(), SQL_HANDLE_STMT);
+                return RecordWrite::Failed;
             }
+            ReferenceCache::getInstance().addStructUnit(recordsInfo.unit_id, recordsInfo.struct_id);
         }
 
 
         // Insert into dbo.data
         if (recordsInfo.data_id == -1) {
+            if (batch) {
+                if (!file->hasContent()) {
+                    return RecordWrite::Failed; // No binary data to insert
+                }
+
+                // The files may be sorted away before the flush, so a queued row keeps its contents in memory
+                for (const auto& f : fileInfo.files) {
+                    f->loadContent();
+                }
+
+                DataBatch::Entry entry;
+                entry.fileInfo = fileInfo;
+                entry.file = file;
+                entry.recordsInfo = recordsInfo;
+                entry.key = rowKey;
+                for (const auto& f : fileInfo.files) {
+                    batch->pendingBytes += f->binaryData.size();
+                }
+                batch->entries.push_back(std::move(entry));
+
+                if (batch->full()) {
+                    flushDataBatch(dbc, *batch, mailingIsActive, dbIsFull);
+                }
+                return RecordWrite::Queued;
+            }
+
             recordsInfo.data_id = insertIntoDataTable(dbc, fileInfo, recordsInfo);
 
             if (recordsInfo.data_id == -1)
-                return;
+                return RecordWrite::Failed;
 
             // Loading users and sending emails
-            sendMailIfActive(mailingIsActive, file->substation, fileInfo, dbc);
+            notifyRecord(dbc, mailingIsActive, file->substation, fileInfo);
         }
         else {
             // Check if we need to update
@@ -1190,36 +1748,106 @@ void Integration::fileIntegrationDB(SQLHDBC dbc, const FileInfo& fileInfo, std::
                     !recordsInfo.hasExpressBinary && fileInfo.hasExpressFile)
                 {
                     updateDataTable(dbc, fileInfo, recordsInfo);
-                    sendMailIfActive(mailingIsActive, file->substation, fileInfo, dbc);
+                    notifyRecord(dbc, mailingIsActive, file->substation, fileInfo);
                 }
             }
         }
 
-        // Insert into dbo.logs 
-        if (recordsInfo.struct_id != -1 && recordsInfo.data_id != -1 && dbIsFull) {
-            insertIntoLogsTable(dbc, fileInfo, recordsInfo.struct_id);
-        }
-
-        // Insert Into dbo.data_process (connected with data)
-        if (recordsInfo.needDataProcess) {
-            if (recordsInfo.dataProcess_id == -1) {
-                auto ef = std::dynamic_pointer_cast<ExpressFile>(file);
-                if (!ef) {
-                    logError(L"[insertIntoProcessTable] Invalid cast to ExpressFile", INTEGRATION_LOG_PATH);
-                    return;
-                }
-                recordsInfo.dataProcess_id = insertIntoProcessTable(dbc, ef, recordsInfo.data_id);
-
-                if (recordsInfo.dataProcess_id == -1)
-                    return;
-            }
-        }
+        finishDataRecord(dbc, fileInfo, file, recordsInfo, dbIsFull);
         //logIntegrationError(L"[Integration] file integration was finished");
+        return RecordWrite::Written;
     }
      
     catch (const std::exception& e) {
         logError(stringToWString("Exception caught in fileIntegrationDB: ") + stringToWString(e.what()), EXCEPTION_LOG_PATH);
     }
+    return RecordWrite::Failed;
+}
+
+void Integration::finishDataRecord(SQLHDBC dbc, const FileInfo& fileInfo, std::shared_ptr<BaseFile> file,
+    RecordsInfoFromDB& recordsInfo, std::atomic_bool& dbIsFull)
+{
+    // Insert into dbo.logs 
+    if (recordsInfo.struct_id != -1 && recordsInfo.data_id != -1 && dbIsFull) {
+        insertIntoLogsTable(dbc, fileInfo, recordsInfo.struct_id);
+    }
+
+    // Insert Into dbo.data_process (connected with data)
+    if (recordsInfo.needDataProcess) {
+        if (recordsInfo.dataProcess_id == -1) {
+            auto ef = std::dynamic_pointer_cast<ExpressFile>(file);
+            if (!ef) {
+                logError(L"[insertIntoProcessTable] Invalid cast to ExpressFile", INTEGRATION_LOG_PATH);
+                return;
+            }
+            recordsInfo.dataProcess_id = insertIntoProcessTable(dbc, ef, recordsInfo.data_id);
+        }
+    }
+}
+
+bool DataBatch::contains(const std::wstring& key) const
+{
+    return std::any_of(entries.begin(), entries.end(), [&key](const Entry& entry) { return entry.key == key; });
+}
+
+void DataBatch::abandon()
+{
+    for (auto& entry : entries) {
+        flushed.push_back({ std::move(entry.fileInfo), false });
+    }
+    entries.clear();
+    pendingBytes = 0;
+}
+
+std::wstring Integration::dataRowKey(const BaseFile& file)
+{
+    std::wstring key = file.unit + L"|" + file.substation + L"|" + file.object + L"|" +
+        std::to_wstring(file.reconNumber) + L"|" + file.fileNum + L"|";
+    // RECON and REXPR of one record share a row, other types are told apart by type and time
+    if (file.filePrefix == L"RECON" || file.filePrefix == L"REXPR") {
+        return key + file.date;
+    }
+    return key + file.filePrefix + L"|" + file.time;
+}
+
+void Integration::flushDataBatch(SQLHDBC dbc, DataBatch& batch, std::atomic_bool& mailingIsActive, std::atomic_bool& dbIsFull)
+{
+    if (batch.entries.empty()) {
+        return;
+    }
+
+    Metrics::getInstance().setGauge("integration.file_bytes_in_memory", static_cast<int64_t>(batch.pendingBytes));
+    Metrics::getInstance().sampleProcessMemory();
+
+    std::vector<DataBatch::Entry> entries;
+    entries.swap(batch.entries);
+    batch.pendingBytes = 0;
+
+    std::vector<int> ids = insertIntoDataTableBatch(dbc, entries);
+    if (ids.size() != entries.size()) {
+        // The batch was rolled back, the rows are inserted one by one and a bad one only loses itself
+        logError(L"[Integration] Batch insert of " + std::to_wstring(entries.size()) + L" data rows failed, inserting row by row",
+            INTEGRATION_LOG_PATH);
+        ids.clear();
+        for (const auto& entry : entries) {
+            ids.push_back(insertIntoDataTable(dbc, entry.fileInfo, entry.recordsInfo));
+        }
+    }
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        DataBatch::Entry& entry = entries[i];
+        if (ids[i] != -1) {
+            try {
+                entry.recordsInfo.data_id = ids[i];
+                notifyRecord(dbc, mailingIsActive, entry.file->substation, entry.fileInfo);
+                finishDataRecord(dbc, entry.fileInfo, entry.file, entry.recordsInfo, dbIsFull);
+            }
+            catch (const std::exception& e) {
+                logError(stringToWString("Exception caught in flushDataBatch: ") + stringToWString(e.what()), EXCEPTION_LOG_PATH);
+            }
+        }
+        batch.flushed.push_back({ std::move(entry.fileInfo), ids[i] != -1 });
+    }
 }
 
 // Helper function for concatenating strings with a separator
@@ -1240,21 +1868,21 @@ void Integration::collectInfo(FileInfo &fileInfo, const fs::directory_entry& ent
 
         //logIntegrationError(L"[Integration] collect info was started");
         std::wstring fileName = entry.path().filename().wstring();              // Name of file ex. (RECON167.759)
-		std::wstring filePrefix = fileName.substr(0, 5);                        // File prefix ex. (RECON or REXPR)
-        if (!isFileNameValid(fileName)) { return; }                             // Checking file name for validity
-        std::wstring baseName = fileName.substr(5);                             // Recon number and file number ex. (167.759)     
+        FileName name = parseFileName(fileName);                                // Prefix and numbers decoded once
+        if (!name.valid() || name.reconNumber < 0) { return; }                  // Checking file name for validity
+        std::wstring filePrefix = name.prefixText();                            // File prefix ex. (RECON or REXPR)
+        std::wstring pairName = name.pairName();                                // Other file of the pair ex. (REXPR167.759)
         std::wstring pathToFile = entry.path().parent_path().wstring() + L"\\"; // Path to file
         std::wstring fullPath = entry.path().wstring();                         // Full path including file name 
-        std::wstring reconNum = fileName.substr(5, 3);                          // Recon num
-        std::wstring fileNum = fileName.substr(9, 3);                           // File num
+        std::wstring fileNum = name.fileNumberText();                           // File num
     
-        if (checkIsDataFile(filePrefix)) {
+        if (name.isData()) {
             auto dataFile = std::make_shared<DataFile>();
             dataFile->fileName = fileName;
             dataFile->parentFolderPath = pathToFile;
             dataFile->fullPath = fullPath;
             dataFile->fileNum = fileNum;
-            dataFile->reconNumber = std::stoi(reconNum);
+            dataFile->reconNumber = name.reconNumber;
 			dataFile->filePrefix = filePrefix;
     
             dataFile->processFile();
@@ -1262,27 +1890,17 @@ void Integration::collectInfo(FileInfo &fileInfo, const fs::directory_entry& ent
             fileInfo.hasDataFile = true;
 			fileInfo.files.push_back(dataFile);
 
-            std::wstring expressFileName = L"REXPR" + baseName;
+            // Only names like recon167.759 have a pair
+            if (pairName.empty()) { return; }
+            std::wstring expressFileName = pairName;
             std::wstring expressFilePath = pathToFile + expressFileName;
     
             // If Express file is not exists, run ОМР-С programm 
             if (!fs::exists(expressFilePath)) {
-                bool containsLetters = std::any_of(baseName.begin(), baseName.end(), [](wchar_t c) {
-                    return std::iswalpha(c);
-                    });
-
-                std::wregex pattern(L"^recon\\d{3}\\.\\d{3}$", std::regex_constants::icase);
-
-                if (!containsLetters) {
-                    if (std::regex_match(fileName, pattern))    {
-                        if (!runExternalProgramWithFlag(pathToOMPExecutable + L"/OMP_C", fullPath)) {
-                            logError(L"File: " + fileName + L" is broken.", LOG_PATH);
-                            return;
-                        }
-                    }
-                    else { return; }
+                if (!runExternalProgramWithFlag(pathToOMPExecutable + L"/OMP_C", fullPath)) {
+                    logError(L"File: " + fileName + L" is broken.", LOG_PATH);
+                    return;
                 }
-                else { return; }
             }
     
             auto expressFile = std::make_shared<ExpressFile>();
@@ -1290,7 +1908,7 @@ void Integration::collectInfo(FileInfo &fileInfo, const fs::directory_entry& ent
             expressFile->parentFolderPath = pathToFile;
             expressFile->fullPath = expressFilePath;
             expressFile->fileNum = fileNum;
-            expressFile->reconNumber = std::stoi(reconNum);
+            expressFile->reconNumber = name.reconNumber;
 			expressFile->filePrefix = L"REXPR";
     
             expressFile->processFile();
@@ -1302,13 +1920,13 @@ void Integration::collectInfo(FileInfo &fileInfo, const fs::directory_entry& ent
             fileInfo.files.push_back(expressFile);
     
         }
-        else if (checkIsExpressFile(filePrefix)) {
+        else if (name.isExpress()) {
             auto expressFile = std::make_shared<ExpressFile>();
             expressFile->fileName = fileName;
             expressFile->parentFolderPath = pathToFile;
             expressFile->fullPath = fullPath;
             expressFile->fileNum = fileNum;
-            expressFile->reconNumber = std::stoi(reconNum);
+            expressFile->reconNumber = name.reconNumber;
             expressFile->filePrefix = filePrefix;
     
             expressFile->processFile();
@@ -1317,15 +1935,15 @@ void Integration::collectInfo(FileInfo &fileInfo, const fs::directory_entry& ent
             fileInfo.files.push_back(expressFile);
     
             auto dataFile = std::make_shared<DataFile>();
-            std::wstring dataFileName = L"RECON" + baseName;
+            std::wstring dataFileName = pairName;
             std::wstring dataFilePath = pathToFile + dataFileName;
 
-            if (fs::exists(dataFilePath)) {
+            if (!pairName.empty() && fs::exists(dataFilePath)) {
                 dataFile->fileName = dataFileName;
                 dataFile->parentFolderPath = pathToFile;
                 dataFile->fullPath = dataFilePath;
                 dataFile->fileNum = fileNum;
-                dataFile->reconNumber = std::stoi(reconNum);
+                dataFile->reconNumber = name.reconNumber;
                 dataFile->filePrefix = L"RECON";
     
                 dataFile->processFile();
@@ -1334,13 +1952,13 @@ void Integration::collectInfo(FileInfo &fileInfo, const fs::directory_entry& ent
                 fileInfo.files.push_back(dataFile);
             }
         }
-        else if (checkIsOtherFiles(fileName)) {
+        else if (name.isOther()) {
             auto baseFile = std::make_shared<BaseFile>();
             baseFile->fileName = fileName;
             baseFile->parentFolderPath = pathToFile;
             baseFile->fullPath = fullPath;
             baseFile->fileNum = fileNum;
-            baseFile->reconNumber = std::stoi(reconNum);
+            baseFile->reconNumber = name.reconNumber;
 			baseFile->filePrefix = filePrefix;
     
             baseFile->processFile();
@@ -1461,43 +2079,38 @@ void Integration::sortFiles(const FileInfo& fileInfo) {
 
 std::wstring Integration::getPathByRNumber(int recon_id,SQLHDBC dbc)
 {
-    SQLHSTMT stmt = SQL_NULL_HSTMT;
-    SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
+    // A folder that no longer exists may have been replaced in FTP_Directories since it was cached
+    std::wstring cachedPath = ReferenceCache::getInstance().localPath(recon_id);
+    boost::system::error_code ec;
+    if (!cachedPath.empty() && fs::is_directory(cachedPath, ec)) {
+        return cachedPath;
+    }
 
     const wchar_t* query = LR"(SELECT d.local_path
         FROM[struct] s 
         JOIN[FTP_Directories] d ON d.struct_id = s.id 
         WHERE s.recon_id = ?)";
 
-    ret = SQLPrepareW(stmt, (SQLWCHAR*)query, SQL_NTS);
-    if (!SQL_SUCCEEDED(ret)) {
-        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    StatementLease stmt = StatementCache::forConnection(dbc).acquire(query);
+    if (!stmt) {
         return std::wstring();
     }
 
-    ret = SQLBindParameter(stmt, 1, SQL_PARAM_INPUT, SQL_C_LONG, SQL_INTEGER, 255, 0,
-        const_cast<int*>(&recon_id), 0, nullptr);
-    if (!SQL_SUCCEEDED(ret)) logSQLError("Failed to bind parameter recon_id", stmt, SQL_HANDLE_STMT);
-
-    ret = SQLExecute(stmt);
-    if (!SQL_SUCCEEDED(ret)) {
-        logSQLError("Failed to execute SQL query in function 'getPathByRNumber' ", stmt, SQL_HANDLE_STMT);
-        SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    if (!SQL_SUCCEEDED(stmt->execute(recon_id))) {
+        logSQLError("Failed to execute SQL query in function 'getPathByRNumber' ", stmt->handle(), SQL_HANDLE_STMT);
         return std::wstring();
     }
 
     std::wstring localPath;
-    wchar_t pathBuffer[512];
-    SQLLEN pathLen = 0;
-
-    while (SQLFetch(stmt) == SQL_SUCCESS) {
-        SQLGetData(stmt, 1, SQL_C_WCHAR, pathBuffer, sizeof(pathBuffer), &pathLen);
-        if (pathLen != SQL_NULL_DATA) {
-            localPath = pathBuffer;  
+    std::wstring path;
+    while (stmt->fetch()) {
+        if (stmt->get(1, path)) {
+            localPath = path;  
         }
     }
-
-    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+    if (!localPath.empty()) {
+        ReferenceCache::getInstance().addLocalPath(recon_id, localPath);
+    }
     return localPath;
 }
 
@@ -0,0 +1,161 @@
+#include "integration_pipeline.h"
+#include "utils.h"
+#include "metrics.h"
+#include "file_catalog.h"
+
+IntegrationPipeline::IntegrationPipeline(const IntegrationEngineConfig& config, const std::wstring& rootFolder,
+    const std::wstring& pathToWinRec, std::atomic_bool& mailingIsActive, std::atomic_bool& dbIsFull)
+    : rootFolder(rootFolder),
+    pathToWinRec(pathToWinRec),
+    mailingIsActive(mailingIsActive),
+    notifyStage("pipeline.notify", 1, config.queueCapacity, [this](RecordNotification& notification) { notify(notification); }),
+    placeStage("pipeline.place", 1, config.queueCapacity, [this](PlaceTask& task) { place(task); }),
+    workers(config, mailingIsActive, dbIsFull, [this](FileInfo&& fileInfo, bool written, std::vector<RecordNotification>&& notifications) {
+        PlaceTask task;
+        task.fileInfo = std::move(fileInfo);
+        task.written = written;
+        task.notifications = std::move(notifications);
+        placeStage.push(std::move(task));
+        }),
+    readStage("pipeline.read", config.readThreads, config.queueCapacity, [this](ReadTask& task) { read(task); })
+{
+}
+
+void IntegrationPipeline::submit(const fs::directory_entry& entry, const std::wstring& targetFolder, bool batched)
+{
+    ReadTask task;
+    task.entry = entry;
+    task.targetFolder = targetFolder;
+    task.batched = batched;
+    readStage.push(std::move(task));
+}
+
+void IntegrationPipeline::drain()
+{
+    // Every stage is empty once the ones before it are, the workers flush their batches on the way
+    readStage.drain();
+    workers.drain();
+    placeStage.drain();
+    notifyStage.drain();
+
+    // Every record marked so far is in the database now
+    FileCatalog::getInstance().commit();
+    Metrics::getInstance().dump();
+}
+
+bool IntegrationPipeline::claim(const FileInfo& fileInfo)
+{
+    std::lock_guard<std::mutex> lock(claimMutex);
+    for (const auto& file : fileInfo.files) {
+        if (claimed.count(file->fullPath)) {
+            return false;
+        }
+    }
+    for (const auto& file : fileInfo.files) {
+        claimed.insert(file->fullPath);
+    }
+    return true;
+}
+
+void IntegrationPipeline::release(const std::vector<std::wstring>& paths)
+{
+    std::lock_guard<std::mutex> lock(claimMutex);
+    for (const auto& path : paths) {
+        claimed.erase(path);
+    }
+}
+
+void IntegrationPipeline::read(ReadTask& task)
+{
+    FileInfo fileInfo;
+    try {
+        // The file may have been placed by the record of its pair partner meanwhile
+        if (!fs::exists(task.entry.path())) {
+            return;
+        }
+
+        Integration::collectInfo(fileInfo, task.entry, rootFolder, pathToWinRec, nullptr);
+        if (fileInfo.files.empty() || !claim(fileInfo)) {
+            return;
+        }
+
+        if (!task.targetFolder.empty()) {
+            // The files are written from Cache and moved to the folder of the recorder afterwards
+            fileInfo.stagingFolder = task.entry.path().parent_path().wstring();
+            for (auto& file : fileInfo.files) {
+                file->parentFolderPath = task.targetFolder;
+                file->processPath(rootFolder);
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        logError(L"[Integration] Exception while reading " + task.entry.path().wstring() + L": " + stringToWString(e.what()), EXCEPTION_LOG_PATH);
+        return;
+    }
+
+    workers.dispatch(std::move(fileInfo), task.batched);
+}
+
+void IntegrationPipeline::place(PlaceTask& task)
+{
+    std::vector<std::wstring> paths;
+    for (const auto& file : task.fileInfo.files) {
+        paths.push_back(file->fullPath);
+    }
+
+    try {
+        bool placed = true;
+        if (!task.fileInfo.stagingFolder.empty()) {
+            for (auto& file : task.fileInfo.files) {
+                std::wstring stagedPath = task.fileInfo.stagingFolder + L"/" + file->fileName;
+                std::wstring finalPath = file->parentFolderPath + L"/" + file->fileName;
+                try {
+                    fs::copy(stagedPath, finalPath, fs::copy_options::overwrite_existing);
+                    fs::remove(stagedPath);
+                    if (fs::exists(stagedPath + L".meta")) {
+                        fs::remove(stagedPath + L".meta");
+                    }
+                    file->fullPath = finalPath;
+                }
+                catch (const std::exception& e) {
+                    placed = false;
+                    logError(L"[MoveFile] Exception while moving file '" + file->fileName + L"' from '" + stagedPath + L"' to '" +
+                        finalPath + L"': " + utf8_to_wstring(e.what()), EXCEPTION_LOG_PATH);
+                }
+            }
+        }
+        if (placed && !task.fileInfo.files.empty()) {
+            Integration::sortFiles(task.fileInfo);
+
+            // Known by the path it was sorted to, a rescan finds it there. A record without its row is
+            // left unmarked, so the next scan writes it again
+            if (task.written) {
+                for (const auto& file : task.fileInfo.files) {
+                    FileCatalog::getInstance().markIntegrated(file->fullPath);
+                }
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        logError(L"[Integration] Exception while placing files: " + stringToWString(e.what()), EXCEPTION_LOG_PATH);
+    }
+    release(paths);
+
+    for (auto& notification : task.notifications) {
+        notifyStage.push(std::move(notification));
+    }
+}
+
+void IntegrationPipeline::notify(RecordNotification& notification)
+{
+    try {
+        if (!notifyDb.isConnected() && !notifyDb.connectToDatabase()) {
+            logError(L"[Mail] Failed to connect to the database for notifications.", EMAIL_LOG_PATH);
+            return;
+        }
+        Integration::sendRecordMail(notifyDb.getConnectionHandle(), mailingIsActive, notification);
+    }
+    catch (const std::exception& e) {
+        logError(L"[Mail] Exception while sending notification: " + stringToWString(e.what()), EXCEPTION_LOG_PATH);
+    }
+}
@@ -0,0 +1,200 @@
+#include "integration_workers.h"
+#include "utils.h"
+#include "metrics.h"
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+IntegrationEngineConfig parseIntegrationEngineConfig(const std::string& jsonString)
+{
+    IntegrationEngineConfig config;
+    if (jsonString.empty()) {
+        return config;
+    }
+
+    try {
+        json configJson = json::parse(jsonString);
+
+        // Only positive numbers override the defaults
+        auto safeSetLimit = [&](const char* key, auto& value) {
+            using T = std::decay_t<decltype(value)>;
+            if (configJson.contains(key) && configJson[key].is_number() && configJson[key].get<double>() > 0) {
+                value = configJson[key].get<T>();
+            }
+            };
+
+        safeSetLimit("workers", config.workers);
+        safeSetLimit("queueCapacity", config.queueCapacity);
+        safeSetLimit("readThreads", config.readThreads);
+        safeSetLimit("scanThreads", config.scanThreads);
+        safeSetLimit("checkpointFiles", config.checkpointFiles);
+    }
+    catch (const json::exception& e) {
+        logError(L"[Integration] Engine config parsing error, defaults are used: " + stringToWString(e.what()), EXCEPTION_LOG_PATH);
+    }
+
+    return config;
+}
+
+IntegrationWorkers::IntegrationWorkers(const IntegrationEngineConfig& config, std::atomic_bool& mailingIsActive, std::atomic_bool& dbIsFull,
+    Persisted persisted)
+    : mailingIsActive(mailingIsActive),
+    dbIsFull(dbIsFull),
+    persisted(std::move(persisted))
+{
+    size_t count = config.workers > 0 ? config.workers : 1;
+    for (size_t i = 0; i < count; ++i) {
+        auto worker = std::make_unique<Worker>(config.queueCapacity);
+
+        // The memory bound of a bulk scan is shared by all workers
+        worker->batch.maxBytes = DataBatch().maxBytes / count;
+        workers.push_back(std::move(worker));
+    }
+
+    for (auto& worker : workers) {
+        Worker* current = worker.get();
+        current->thread = std::thread([this, current]() { work(*current); });
+    }
+}
+
+IntegrationWorkers::~IntegrationWorkers()
+{
+    for (auto& worker : workers) {
+        worker->queue.close();
+    }
+    for (auto& worker : workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+void IntegrationWorkers::dispatch(FileInfo fileInfo, bool batched)
+{
+    if (fileInfo.files.empty()) {
+        return;
+    }
+
+    Task task;
+    task.fileInfo = std::move(fileInfo);
+    task.batched = batched;
+    workers[shardOf(task.fileInfo)]->queue.push(std::move(task));
+    publishDepth();
+}
+
+void IntegrationWorkers::drain()
+{
+    std::vector<std::future<void>> pending;
+    for (auto& worker : workers) {
+        Task marker;
+        marker.drained = std::make_shared<std::promise<void>>();
+        pending.push_back(marker.drained->get_future());
+        if (!worker->queue.push(std::move(marker))) {
+            pending.pop_back();
+        }
+    }
+    for (auto& future : pending) {
+        future.wait();
+    }
+}
+
+size_t IntegrationWorkers::shardOf(const FileInfo& fileInfo) const
+{
+    // Both files of a pair come from one recorder
+    return std::hash<int>()(fileInfo.files.front()->reconNumber) % workers.size();
+}
+
+void IntegrationWorkers::publishDepth() const
+{
+    size_t depth = 0;
+    for (const auto& worker : workers) {
+        depth += worker->queue.size();
+    }
+    Metrics::getInstance().setGauge("pipeline.persist.queue_depth", static_cast<int64_t>(depth));
+}
+
+void IntegrationWorkers::forward(FileInfo& fileInfo, bool written, std::vector<RecordNotification>& notifications)
+{
+    if (!persisted || (fileInfo.files.empty() && notifications.empty())) {
+        return;
+    }
+    try {
+        persisted(std::move(fileInfo), written, std::move(notifications));
+    }
+    catch (const std::exception& e) {
+        logError(L"[Integration] Exception while handing over a written record: " + stringToWString(e.what()), EXCEPTION_LOG_PATH);
+    }
+    notifications.clear();
+}
+
+void IntegrationWorkers::forwardFlushed(DataBatch& batch, std::vector<RecordNotification>& notifications)
+{
+    std::vector<DataBatch::Flushed> flushed;
+    flushed.swap(batch.flushed);
+    for (auto& record : flushed) {
+        forward(record.fileInfo, record.written, notifications);
+    }
+}
+
+void IntegrationWorkers::work(Worker& worker)
+{
+    // With a receiver the mail waits until the files of the record are in place
+    std::vector<RecordNotification> notifications;
+    if (persisted) {
+        Integration::setNotificationSink(&notifications);
+    }
+
+    Task task;
+    while (worker.queue.pop(task)) {
+        publishDepth();
+        RecordWrite result = RecordWrite::Failed;
+        try {
+            // A lost connection is opened again, the records of the meantime are skipped as before
+            if (!worker.db.isConnected() && !worker.db.connectToDatabase()) {
+                logError(L"[Integration] Worker failed to connect to the database.", INTEGRATION_LOG_PATH);
+                if (task.drained) {
+                    worker.batch.abandon();
+                }
+            }
+            else if (task.drained) {
+                Integration::flushDataBatch(worker.db.getConnectionHandle(), worker.batch, mailingIsActive, dbIsFull);
+            }
+            else {
+                result = Integration::fileIntegrationDB(worker.db.getConnectionHandle(), task.fileInfo, mailingIsActive, dbIsFull,
+                    task.batched ? &worker.batch : nullptr);
+            }
+        }
+        catch (const std::exception& e) {
+            logError(L"[Integration] Exception in integration worker: " + stringToWString(e.what()), EXCEPTION_LOG_PATH);
+        }
+        catch (...) {
+            logError(L"[Integration] Unknown exception in integration worker", EXCEPTION_LOG_PATH);
+        }
+
+        // The record moves on even if it could not be written, as sorting never depended on the database.
+        // Only written ones are marked integrated, the rows flushed meanwhile were dispatched earlier
+        forwardFlushed(worker.batch, notifications);
+        if (result != RecordWrite::Queued) {
+            forward(task.fileInfo, result == RecordWrite::Written, notifications);
+        }
+        if (task.drained) {
+            task.drained->set_value();
+        }
+        task = Task();
+    }
+
+    try {
+        if (worker.db.isConnected()) {
+            Integration::flushDataBatch(worker.db.getConnectionHandle(), worker.batch, mailingIsActive, dbIsFull);
+            worker.db.disconnectFromDatabase();
+        }
+    }
+    catch (const std::exception& e) {
+        logError(L"[Integration] Exception while stopping integration worker: " + stringToWString(e.what()), EXCEPTION_LOG_PATH);
+    }
+    worker.batch.abandon();
+    forwardFlushed(worker.batch, notifications);
+    FileInfo none;
+    forward(none, false, notifications);
+    Integration::setNotificationSink(nullptr);
+}
@@ -0,0 +1,54 @@
+#include "metrics.h"
+#include "utils.h"
+#include <Windows.h>
+#include <psapi.h>
+
+void Metrics::add(const std::string& name, uint64_t value)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    counters[name] += value;
+}
+
+void Metrics::setGauge(const std::string& name, int64_t value)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Gauge& gauge = gauges[name];
+    gauge.value = value;
+    if (value > gauge.highWater) {
+        gauge.highWater = value;
+    }
+}
+
+void Metrics::sampleProcessMemory()
+{
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        setGauge("process.working_set_bytes", static_cast<int64_t>(counters.WorkingSetSize));
+    }
+}
+
+uint64_t Metrics::counter(const std::string& name) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = counters.find(name);
+    return it != counters.end() ? it->second : 0;
+}
+
+void Metrics::dump()
+{
+    std::wstring line;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& counter : counters) {
+            line += stringToWString(counter.first) + L"=" + std::to_wstring(counter.second) + L" ";
+        }
+        for (const auto& gauge : gauges) {
+            line += stringToWString(gauge.first) + L"=" + std::to_wstring(gauge.second.value) +
+                L" (max " + std::to_wstring(gauge.second.highWater) + L") ";
+        }
+    }
+
+    if (!line.empty()) {
+        logError(L"[Metrics] " + line, METRICS_LOG_PATH);
+    }
+}
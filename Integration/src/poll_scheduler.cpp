@@ -0,0 +1,71 @@
+#include "poll_scheduler.h"
+#include <algorithm>
+
+void PollScheduler::configure(std::chrono::seconds minInterval, std::chrono::seconds maxInterval)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->minInterval = minInterval.count() > 0 ? minInterval : std::chrono::seconds(1);
+    this->maxInterval = maxInterval > this->minInterval ? maxInterval : this->minInterval;
+}
+
+bool PollScheduler::isDue(const std::string& key) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    return it == entries.end() || Clock::now() >= it->second.nextPoll;
+}
+
+void PollScheduler::recordPoll(const std::string& key, size_t filesFound, bool backlog)
+{
+    using namespace std::chrono;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = Clock::now();
+
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        Entry entry;
+        entry.lastPoll = now;
+        entry.interval = minInterval;
+        entry.nextPoll = now + entry.interval;
+        entries[key] = entry;
+        return;
+    }
+
+    Entry& entry = it->second;
+    double elapsed = duration_cast<duration<double>>(now - entry.lastPoll).count();
+    if (elapsed > 0) {
+        double sample = static_cast<double>(filesFound) / elapsed;
+        entry.arrivalRate = rateSmoothing * sample + (1.0 - rateSmoothing) * entry.arrivalRate;
+    }
+    entry.lastPoll = now;
+
+    if (backlog) {
+        // Files are left on the recorder, come back as soon as allowed
+        entry.interval = minInterval;
+    }
+    else if (filesFound > 0 && entry.arrivalRate > 0) {
+        auto wanted = seconds(static_cast<long long>(targetFilesPerPoll / entry.arrivalRate));
+        entry.interval = std::clamp(wanted, minInterval, maxInterval);
+    }
+    else {
+        // Nothing arrived, every empty listing doubles the pause
+        entry.interval = std::clamp(entry.interval * 2, minInterval, maxInterval);
+    }
+    entry.nextPoll = now + entry.interval;
+}
+
+std::chrono::seconds PollScheduler::timeUntilNextPoll() const
+{
+    using namespace std::chrono;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = Clock::now();
+    seconds wait = maxInterval;
+    for (const auto& entry : entries) {
+        auto left = duration_cast<seconds>(entry.second.nextPoll - now);
+        wait = std::min(wait, left);
+    }
+    // Directories that could not be polled stay due, they must not turn this into a busy loop
+    return std::max(wait, minInterval);
+}
@@ -0,0 +1,160 @@
+#include "reference_cache.h"
+#include "statement_cache.h"
+#include "utils.h"
+
+bool ReferenceCache::load(SQLHDBC dbc)
+{
+    std::map<std::pair<std::wstring, std::wstring>, int> loadedUnits;
+    std::map<std::pair<int, std::wstring>, int> loadedStructs;
+    std::set<std::pair<int, int>> loadedStructUnits;
+    std::map<int, std::wstring> loadedPaths;
+
+    StatementCache& statements = StatementCache::forConnection(dbc);
+
+    // The tables are read into local maps first, a failed query leaves the cache as it was
+    {
+        StatementLease stmt = statements.acquire(L"SELECT [id], [unit], [substation] FROM [units];");
+        if (!stmt || !SQL_SUCCEEDED(stmt->execute())) {
+            logError(L"[Integration] Failed to load units into the reference cache", INTEGRATION_LOG_PATH);
+            return false;
+        }
+        int id = -1;
+        std::wstring unit, substation;
+        while (stmt->fetch()) {
+            if (stmt->get(1, id) && stmt->get(2, unit) && stmt->get(3, substation)) {
+                loadedUnits[{ unit, substation }] = id;
+            }
+        }
+    }
+    {
+        StatementLease stmt = statements.acquire(L"SELECT [id], [recon_id], [object] FROM [struct];");
+        if (!stmt || !SQL_SUCCEEDED(stmt->execute())) {
+            logError(L"[Integration] Failed to load struct into the reference cache", INTEGRATION_LOG_PATH);
+            return false;
+        }
+        int id = -1, reconId = 0;
+        std::wstring object;
+        while (stmt->fetch()) {
+            if (stmt->get(1, id) && stmt->get(2, reconId) && stmt->get(3, object)) {
+                loadedStructs[{ reconId, object }] = id;
+            }
+        }
+    }
+    {
+        StatementLease stmt = statements.acquire(L"SELECT [unit_id], [struct_id] FROM [struct_units];");
+        if (!stmt || !SQL_SUCCEEDED(stmt->execute())) {
+            logError(L"[Integration] Failed to load struct_units into the reference cache", INTEGRATION_LOG_PATH);
+            return false;
+        }
+        int unitId = -1, structId = -1;
+        while (stmt->fetch()) {
+            if (stmt->get(1, unitId) && stmt->get(2, structId)) {
+                loadedStructUnits.insert({ unitId, structId });
+            }
+        }
+    }
+    if (!queryLocalPaths(statements, loadedPaths)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    units.swap(loadedUnits);
+    structs.swap(loadedStructs);
+    structUnits.swap(loadedStructUnits);
+    localPaths.swap(loadedPaths);
+
+    logError(L"[Integration] Reference cache loaded: " + std::to_wstring(units.size()) + L" units, " +
+        std::to_wstring(structs.size()) + L" structs, " + std::to_wstring(localPaths.size()) + L" local paths", INTEGRATION_LOG_PATH);
+    return true;
+}
+
+bool ReferenceCache::reloadLocalPaths(SQLHDBC dbc)
+{
+    std::map<int, std::wstring> loadedPaths;
+    if (!queryLocalPaths(StatementCache::forConnection(dbc), loadedPaths)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    localPaths.swap(loadedPaths);
+    return true;
+}
+
+bool ReferenceCache::queryLocalPaths(StatementCache& statements, std::map<int, std::wstring>& loadedPaths)
+{
+    StatementLease stmt = statements.acquire(LR"(SELECT s.recon_id, d.local_path
+        FROM[struct] s 
+        JOIN[FTP_Directories] d ON d.struct_id = s.id)");
+    if (!stmt || !SQL_SUCCEEDED(stmt->execute())) {
+        logError(L"[Integration] Failed to load FTP_Directories into the reference cache", INTEGRATION_LOG_PATH);
+        return false;
+    }
+    int reconId = 0;
+    std::wstring path;
+    while (stmt->fetch()) {
+        if (stmt->get(1, reconId) && stmt->get(2, path)) {
+            loadedPaths[reconId] = path;
+        }
+    }
+    return true;
+}
+
+void ReferenceCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    units.clear();
+    structs.clear();
+    structUnits.clear();
+    localPaths.clear();
+}
+
+int ReferenceCache::unitId(const std::wstring& unit, const std::wstring& substation) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = units.find({ unit, substation });
+    return it != units.end() ? it->second : -1;
+}
+
+int ReferenceCache::structId(int reconId, const std::wstring& object) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = structs.find({ reconId, object });
+    return it != structs.end() ? it->second : -1;
+}
+
+bool ReferenceCache::hasStructUnit(int unitId, int structId) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return structUnits.count({ unitId, structId }) > 0;
+}
+
+std::wstring ReferenceCache::localPath(int reconId) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = localPaths.find(reconId);
+    return it != localPaths.end() ? it->second : std::wstring();
+}
+
+void ReferenceCache::addUnit(const std::wstring& unit, const std::wstring& substation, int id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    units[{ unit, substation }] = id;
+}
+
+void ReferenceCache::addStruct(int reconId, const std::wstring& object, int id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    structs[{ reconId, object }] = id;
+}
+
+void ReferenceCache::addStructUnit(int unitId, int structId)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    structUnits.insert({ unitId, structId });
+}
+
+void ReferenceCache::addLocalPath(int reconId, const std::wstring& path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    localPaths[reconId] = path;
+}
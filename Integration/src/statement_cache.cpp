@@ -0,0 +1,143 @@
+#include "statement_cache.h"
+#include "utils.h"
+
+std::mutex StatementCache::registryMutex;
+std::map<SQLHDBC, std::unique_ptr<StatementCache>> StatementCache::registry;
+
+CachedStatement::~CachedStatement()
+{
+    if (hstmt != SQL_NULL_HSTMT) {
+        SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    }
+}
+
+void CachedStatement::reset(size_t parameterCount)
+{
+    SQLFreeStmt(hstmt, SQL_CLOSE);
+    SQLFreeStmt(hstmt, SQL_RESET_PARAMS);
+    indicators.assign(parameterCount, 0);
+}
+
+bool CachedStatement::bind(SQLUSMALLINT index, const int& value)
+{
+    SQLRETURN ret = SQLBindParameter(hstmt, index, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0,
+        const_cast<int*>(&value), 0, nullptr);
+    return SQL_SUCCEEDED(ret);
+}
+
+bool CachedStatement::bind(SQLUSMALLINT index, const std::wstring& value)
+{
+    // Declared sizes are bucketed, every length would otherwise be a new parameter signature on the server
+    SQLULEN columnSize = value.size() <= 255 ? 255 : (value.size() <= 4000 ? 4000 : 0);
+    SQLSMALLINT sqlType = columnSize ? SQL_WVARCHAR : SQL_WLONGVARCHAR;
+
+    SQLLEN& indicator = indicators[index - 1];
+    indicator = static_cast<SQLLEN>(value.size() * sizeof(wchar_t));
+    SQLRETURN ret = SQLBindParameter(hstmt, index, SQL_PARAM_INPUT, SQL_C_WCHAR, sqlType, columnSize, 0,
+        (SQLPOINTER)value.c_str(), indicator, &indicator);
+    return SQL_SUCCEEDED(ret);
+}
+
+bool CachedStatement::bind(SQLUSMALLINT index, const SqlBinary& value)
+{
+    SQLLEN& indicator = indicators[index - 1];
+    indicator = value.data ? value.size : SQL_NULL_DATA;
+    SQLRETURN ret = SQLBindParameter(hstmt, index, SQL_PARAM_INPUT, SQL_C_BINARY, SQL_LONGVARBINARY, value.size, 0,
+        const_cast<void*>(value.data), value.size, &indicator);
+    return SQL_SUCCEEDED(ret);
+}
+
+bool CachedStatement::bind(SQLUSMALLINT index, const SqlStream& value)
+{
+    SQLLEN& indicator = indicators[index - 1];
+    indicator = value.token ? SQL_LEN_DATA_AT_EXEC(value.size) : SQL_NULL_DATA;
+    SQLRETURN ret = SQLBindParameter(hstmt, index, SQL_PARAM_INPUT, SQL_C_BINARY, SQL_LONGVARBINARY, value.size, 0,
+        const_cast<void*>(value.token), 0, &indicator);
+    return SQL_SUCCEEDED(ret);
+}
+
+bool CachedStatement::fetch()
+{
+    SQLRETURN ret = SQLFetch(hstmt);
+    return ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO;
+}
+
+bool CachedStatement::get(SQLUSMALLINT column, int& value)
+{
+    SQLLEN indicator = 0;
+    int result = 0;
+    SQLRETURN ret = SQLGetData(hstmt, column, SQL_C_SLONG, &result, 0, &indicator);
+    if (!SQL_SUCCEEDED(ret) || indicator == SQL_NULL_DATA) {
+        return false;
+    }
+    value = result;
+    return true;
+}
+
+bool CachedStatement::get(SQLUSMALLINT column, std::wstring& value)
+{
+    wchar_t buffer[512];
+    SQLLEN indicator = 0;
+    value.clear();
+
+    // Long values come in several parts
+    SQLRETURN ret;
+    while ((ret = SQLGetData(hstmt, column, SQL_C_WCHAR, buffer, sizeof(buffer), &indicator)) != SQL_NO_DATA) {
+        if (!SQL_SUCCEEDED(ret) || indicator == SQL_NULL_DATA) {
+            return false;
+        }
+        size_t available = (indicator == SQL_NO_TOTAL || indicator >= static_cast<SQLLEN>(sizeof(buffer)))
+            ? sizeof(buffer) / sizeof(wchar_t) - 1
+            : indicator / sizeof(wchar_t);
+        value.append(buffer, available);
+        if (ret == SQL_SUCCESS) {
+            break;
+        }
+    }
+    return true;
+}
+
+void CachedStatement::close()
+{
+    SQLFreeStmt(hstmt, SQL_CLOSE);
+}
+
+StatementCache& StatementCache::forConnection(SQLHDBC dbc)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto& cache = registry[dbc];
+    if (!cache) {
+        cache.reset(new StatementCache(dbc));
+    }
+    return *cache;
+}
+
+void StatementCache::release(SQLHDBC dbc)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.erase(dbc);
+}
+
+StatementLease StatementCache::acquire(const std::wstring& sql)
+{
+    auto it = statements.find(sql);
+    if (it != statements.end()) {
+        return StatementLease(it->second.get());
+    }
+
+    SQLHSTMT hstmt = SQL_NULL_HSTMT;
+    if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_STMT, dbc, &hstmt))) {
+        logError(L"[Database] Failed to allocate SQL statement handle for the statement cache", LOG_PATH);
+        return StatementLease(nullptr);
+    }
+
+    auto statement = std::make_unique<CachedStatement>(hstmt);
+    if (!SQL_SUCCEEDED(SQLPrepareW(hstmt, (SQLWCHAR*)sql.c_str(), SQL_NTS))) {
+        logError(L"[Database] Failed to prepare cached statement: " + sql, LOG_PATH);
+        return StatementLease(nullptr);
+    }
+
+    CachedStatement* result = statement.get();
+    statements.emplace(sql, std::move(statement));
+    return StatementLease(result);
+}
@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "cp866_decoder.h"
 
 #ifdef UNICODE
 #define SQLTCHAR SQLWCHAR
@@ -146,21 +147,8 @@ std::string wstringToString(const std::wstring& wstr)
 }
 
 std::string cp866_to_utf8(const std::string& cp866_str) {
-    iconv_t conv = iconv_open("UTF-8", "CP866");
-    if (conv == (iconv_t)-1) {
-        return "";
-    }
-    size_t inBytesLeft = cp866_str.size();
-    size_t outBytesLeft = inBytesLeft * 2; // UTF-8 can take up to 2 bytes for every CP866 byte
-    std::vector<char> outBuf(outBytesLeft);
-    char* inBuf = const_cast<char*>(cp866_str.data());
-    char* outPtr = outBuf.data();
-    if (iconv(conv, &inBuf, &inBytesLeft, &outPtr, &outBytesLeft) == (size_t)-1) {
-        iconv_close(conv);
-        return "";
-    }
-    iconv_close(conv);
-    return std::string(outBuf.data(), outBuf.size() - outBytesLeft);
+    // Table lookup instead of an iconv descriptor per call, box drawing characters take 3 bytes in UTF-8
+    return Cp866Decoder::forThisThread().toUtf8(cp866_str.data(), cp866_str.size());
 }
 
 std::string base64Encode(const std::string& input)
@@ -0,0 +1,61 @@
+﻿#ifndef EXPRESS_HEADER_REFERENCE_H
+#define EXPRESS_HEADER_REFERENCE_H
+
+#include <regex>
+#include <string>
+#include "express_header.h"
+#include "cp866_decoder.h"
+
+// The former reading of REXPR fields with std::wregex, kept as the reference for parseExpressHeader.
+// Patterns and parameter lookup are those of ExpressFile::readDataFromFile and Integration::extractParamValue.
+// The text is decoded by Cp866Decoder, so only the reading of the fields is compared
+namespace reference {
+
+inline std::wstring firstGroup(const std::wstring& text, const std::wregex& pattern) {
+    std::wsmatch match;
+    if (std::regex_search(text, match, pattern) && match.size() > 1) {
+        return match.str(1);
+    }
+    return L"";
+}
+
+// The last occurrence of a marker, up to the next '$' or the end
+inline std::wstring paramValue(const std::wstring& text, const std::wstring& marker) {
+    size_t pos = text.rfind(marker);
+    if (pos == std::wstring::npos) {
+        return L"";
+    }
+    size_t start = pos + marker.size();
+    size_t end = text.find(L'$', start);
+    return end == std::wstring::npos ? text.substr(start) : text.substr(start, end - start);
+}
+
+inline ExpressHeader parseExpressHeader(const char* data, size_t size) {
+    static const std::wregex datePattern(L"Дата\\s*:?\\s*(\\d{2}/\\d{2}/\\d{4})");
+    static const std::wregex timePattern(L"Время(?:\\s+пуска)?\\s*:?\\s*(\\d{2}:\\d{2}:\\d{2}\\.\\d{3})");
+    static const std::wregex factorPattern(L"Фактор пуска:\\s*(.*)");
+    static const std::wregex typeKzPattern(L"Повреждение.*:\\s*(.*)");
+    static const std::wregex damagedLinePattern(L"Поврежденная линия, предположительно:\\s*(.*)");
+
+    std::wstring text = Cp866Decoder::forThisThread().toWide(data, size);
+
+    ExpressHeader header;
+    header.date = firstGroup(text, datePattern);
+    header.time = firstGroup(text, timePattern);
+    header.factor = firstGroup(text, factorPattern);
+    header.typeKz = firstGroup(text, typeKzPattern);
+    header.damagedLine = firstGroup(text, damagedLinePattern);
+
+    // Older recorders only have the parameters, they were looked up when a line was missing
+    if (header.date.empty() || header.time.empty() || header.factor.empty() || header.typeKz.empty()) {
+        header.paramDate = paramValue(text, L"$DP=");
+        header.paramTime = paramValue(text, L"$TP=");
+        header.paramFactor = paramValue(text, L"$SF=");
+        header.paramLineFault = paramValue(text, L"$LF=");
+    }
+    return header;
+}
+
+} // namespace reference
+
+#endif // EXPRESS_HEADER_REFERENCE_H
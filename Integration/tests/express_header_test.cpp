@@ -0,0 +1,179 @@
+﻿// Golden samples and a differential check of parseExpressHeader against the former regex reading.
+// Usage: express_header_test <golden folder> [--regenerate]
+// Every NAME.rexpr of the folder is a CP866 file, NAME.expected holds its fields as "field=value" lines
+// in UTF-8. --regenerate writes the expected files from the regex reference
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "express_header.h"
+#include "express_header_reference.h"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+const size_t GENERATED_DOCUMENTS = 20000;
+
+// UTF-8 with control characters escaped, one value stays on one line
+std::string escape(const std::wstring& value) {
+    std::string out;
+    for (wchar_t c : value) {
+        if (c == L'\\') out += "\\\\";
+        else if (c == L'\r') out += "\\r";
+        else if (c == L'\n') out += "\\n";
+        else if (c == L'\t') out += "\\t";
+        else if (c < 0x20) {
+            char hex[8];
+            std::snprintf(hex, sizeof(hex), "\\x%02x", static_cast<unsigned>(c));
+            out += hex;
+        }
+        else if (c < 0x80) out += static_cast<char>(c);
+        else if (c < 0x800) {
+            out += static_cast<char>(0xC0 | (c >> 6));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else {
+            out += static_cast<char>(0xE0 | (c >> 12));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+    return out;
+}
+
+// The parameters only count when a line is missing (ExpressFile::readMetadata). The parser may keep
+// the ones it passed before the last line was found, those are not compared
+std::string describe(ExpressHeader header) {
+    if (!header.date.empty() && !header.time.empty() && !header.factor.empty() && !header.typeKz.empty()) {
+        header.paramDate.clear();
+        header.paramTime.clear();
+        header.paramFactor.clear();
+        header.paramLineFault.clear();
+    }
+
+    std::ostringstream out;
+    out << "date=" << escape(header.date) << "\n"
+        << "time=" << escape(header.time) << "\n"
+        << "factor=" << escape(header.factor) << "\n"
+        << "typeKz=" << escape(header.typeKz) << "\n"
+        << "damagedLine=" << escape(header.damagedLine) << "\n"
+        << "paramDate=" << escape(header.paramDate) << "\n"
+        << "paramTime=" << escape(header.paramTime) << "\n"
+        << "paramFactor=" << escape(header.paramFactor) << "\n"
+        << "paramLineFault=" << escape(header.paramLineFault) << "\n";
+    return out.str();
+}
+
+std::string readFile(const fs::path& path) {
+    std::ifstream in(path.string(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// CP866 bytes of a text, built from the decoding table
+std::string toCp866(const std::wstring& text) {
+    static std::wstring table;
+    if (table.empty()) {
+        std::string bytes;
+        for (int b = 0; b < 256; ++b) {
+            bytes += static_cast<char>(b);
+        }
+        table = Cp866Decoder::forThisThread().toWide(bytes.data(), bytes.size());
+    }
+    std::string out;
+    for (wchar_t c : text) {
+        size_t pos = table.find(c);
+        out += static_cast<char>(pos == std::wstring::npos ? '?' : pos);
+    }
+    return out;
+}
+
+size_t checkGolden(const fs::path& folder, bool regenerate, size_t& samples) {
+    size_t failures = 0;
+    std::vector<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(folder)) {
+        if (entry.path().extension() == ".rexpr") {
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    for (const auto& file : files) {
+        std::string content = readFile(file);
+        fs::path expectedPath = fs::path(file).replace_extension(".expected");
+        std::string former = describe(reference::parseExpressHeader(content.data(), content.size()));
+        ++samples;
+
+        if (regenerate) {
+            std::ofstream(expectedPath.string(), std::ios::binary) << former;
+            continue;
+        }
+
+        std::string expected = readFile(expectedPath);
+        std::string parsed = describe(parseExpressHeader(content.data(), content.size()));
+        if (parsed != expected || former != expected) {
+            ++failures;
+            std::printf("FAIL %s\n--- expected\n%s--- parseExpressHeader\n%s--- regex reference\n%s",
+                file.filename().string().c_str(), expected.c_str(), parsed.c_str(), former.c_str());
+        }
+    }
+    return failures;
+}
+
+// Documents glued from pieces of headers, both readings have to agree on every one of them
+size_t checkGenerated() {
+    const std::vector<std::wstring> pieces = {
+        L"Дата", L"Дата: ", L"Дата :", L" ", L"\t", L"\r\n", L"\n", L":", L"29/07/2024", L"2/07/2024",
+        L"Время", L"Время пуска", L"Время  пуска:", L"12:30:15.250", L"12:30:15",
+        L"Фактор пуска:", L"Фактор пуска: U<", L"Повреждение", L"Повреждение фаз: ", L"Повреждение A:B: C", L"AB0",
+        L"Поврежденная линия, предположительно:", L" Л-110 Южная",
+        L"$DP=", L"$TP=", L"$SF=", L"$LF=", L"2", L"$", L"x", L"Объект: ПС-1", L"пуска", L"ДатаДата", L"00/00/0000",
+        L"╔═╗", L"°"
+    };
+
+    std::mt19937 random(7);
+    size_t failures = 0;
+    for (size_t i = 0; i < GENERATED_DOCUMENTS; ++i) {
+        std::wstring text;
+        size_t count = random() % 30;
+        for (size_t j = 0; j < count; ++j) {
+            text += pieces[random() % pieces.size()];
+        }
+        std::string content = toCp866(text);
+
+        std::string parsed = describe(parseExpressHeader(content.data(), content.size()));
+        std::string former = describe(reference::parseExpressHeader(content.data(), content.size()));
+        if (parsed != former && failures++ < 3) {
+            std::printf("FAIL generated document %zu: %s\n--- parseExpressHeader\n%s--- regex reference\n%s",
+                i, escape(text).c_str(), parsed.c_str(), former.c_str());
+        }
+    }
+    return failures;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::printf("Usage: express_header_test <golden folder> [--regenerate]\n");
+        return 2;
+    }
+    bool regenerate = argc > 2 && std::string(argv[2]) == "--regenerate";
+
+    size_t samples = 0;
+    size_t failures = checkGolden(argv[1], regenerate, samples);
+    if (regenerate) {
+        std::printf("Regenerated %zu expected files\n", samples);
+        return 0;
+    }
+    failures += checkGenerated();
+
+    std::printf("%zu golden samples, %zu generated documents, %zu failures\n", samples, GENERATED_DOCUMENTS, failures);
+    return failures == 0 && samples > 0 ? 0 : 1;
+}